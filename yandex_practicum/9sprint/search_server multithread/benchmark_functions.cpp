@@ -0,0 +1,460 @@
+#include "benchmark_functions.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <execution>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <malloc.h>
+#include "durable_search_server.h"
+#include "log_duration.h"
+#include "posting_kernels.h"
+#include "process_memory.h"
+#include "search_server.h"
+#include "segmented_search_server.h"
+
+using namespace std;
+
+namespace {
+
+const string STOP_WORDS = "and with"s;
+
+// документы и запросы со словами по закону Ципфа: слово ранга r встречается с частотой 1/r
+class ZipfCorpus {
+public:
+    explicit ZipfCorpus(unsigned seed)
+        : generator_(seed) {
+        const int word_count = 50000;
+        vector<double> weights(word_count);
+        for (int rank = 0; rank < word_count; ++rank) {
+            string word;
+            const int length = 3 + generator_() % 6;
+            for (int i = 0; i < length; ++i) {
+                word.push_back(static_cast<char>('a' + generator_() % 26));
+            }
+            words_.push_back(word + to_string(rank));
+            weights[rank] = 1.0 / (rank + 1);
+        }
+        rank_ = discrete_distribution<int>(weights.begin(), weights.end());
+    }
+
+    string MakeDocument() {
+        string text;
+        const int length = 6 + generator_() % 10;
+        for (int i = 0; i < length; ++i) {
+            text += words_[rank_(generator_)];
+            text += ' ';
+        }
+        return text;
+    }
+
+    vector<string> MakeDocuments(int count) {
+        vector<string> texts(count);
+        for (string& text : texts) {
+            text = MakeDocument();
+        }
+        return texts;
+    }
+
+    // запросы из 2-6 слов, каждое шестое - минус-слово
+    vector<string> MakeQueries(int count) {
+        vector<string> queries(count);
+        for (string& query : queries) {
+            const int length = 2 + generator_() % 5;
+            for (int i = 0; i < length; ++i) {
+                if (generator_() % 6 == 0) {
+                    query += '-';
+                }
+                query += words_[rank_(generator_) % 20000];
+                query += ' ';
+            }
+        }
+        return queries;
+    }
+
+private:
+    mt19937 generator_;
+    vector<string> words_;
+    discrete_distribution<int> rank_;
+};
+
+template <typename Action>
+double MeasureSeconds(Action action) {
+    const auto start = chrono::steady_clock::now();
+    action();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void ReportRate(const string& name, size_t count, double seconds, const string& unit) {
+    cerr << name << ": "s << count << " "s << unit << " in "s << static_cast<int64_t>(seconds * 1000) << " ms, "s
+        << static_cast<int64_t>(count / seconds) << " "s << unit << "/s"s << endl;
+}
+
+// число вхождений - число разных слов документа без стоп-слов
+size_t CountPostings(const vector<string>& texts) {
+    size_t postings = 0;
+    for (const string& text : texts) {
+        const vector<string_view> words = SplitIntoWords(text);
+        postings += set<string_view>(words.begin(), words.end()).size();
+    }
+    return postings;
+}
+
+// писатель с приоритетом над читателями: shared_mutex из glibc не даёт писателю войти, пока читатели идут подряд
+class WriterPriorityMutex {
+public:
+    void lock() {
+        lock_guard turnstile(turnstile_);
+        mutex_.lock();
+    }
+    void unlock() {
+        mutex_.unlock();
+    }
+    void lock_shared() {
+        {
+            lock_guard turnstile(turnstile_);
+        }
+        mutex_.lock_shared();
+    }
+    void unlock_shared() {
+        mutex_.unlock_shared();
+    }
+
+private:
+    mutex turnstile_;
+    shared_mutex mutex_;
+};
+
+// пока один поток добавляет документы и удаляет каждый четвёртый старый, reader_count потоков ищут
+template <typename Add, typename Remove, typename Find>
+void RunMixedWorkload(const string& name, const vector<string>& texts, int first_id, const vector<string>& queries,
+    int reader_count, double seconds, Add add, Remove remove, Find find) {
+    atomic<bool> done = false;
+    atomic<size_t> query_count = 0;
+    vector<thread> readers;
+    for (int reader = 0; reader < reader_count; ++reader) {
+        readers.emplace_back([&, reader]() {
+            for (size_t i = reader * 997; !done; ++i) {
+                find(queries[i % queries.size()]);
+                ++query_count;
+            }
+            });
+    }
+    size_t write_count = 0;
+    const double elapsed = MeasureSeconds([&]() {
+        const auto deadline = chrono::steady_clock::now() + chrono::duration<double>(seconds);
+        for (int id = first_id; id < static_cast<int>(texts.size()) && chrono::steady_clock::now() < deadline; ++id, ++write_count) {
+            add(id, texts[id]);
+            if (id % 4 == 0) {
+                remove(id - first_id);
+            }
+        }
+        });
+    done = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    ReportRate(name + " writes"s, write_count, elapsed, "docs"s);
+    ReportRate(name + " queries"s, query_count, elapsed, "queries"s);
+}
+
+} // namespace
+
+void BenchmarkPostingLayouts(int document_count) {
+    // индекс на std::map<int, double> для каждого слова, с которым сравнивались плоские списки,
+    // в дереве не сохранился, поэтому сравниваются два нынешних формата
+    ZipfCorpus corpus(7);
+    const vector<string> texts = corpus.MakeDocuments(document_count);
+    const vector<string> queries = corpus.MakeQueries(2000);
+    const size_t postings = CountPostings(texts);
+    for (const PostingLayout layout : { PostingLayout::PLAIN, PostingLayout::COMPRESSED }) {
+        const string name = layout == PostingLayout::PLAIN ? "PLAIN"s : "COMPRESSED"s;
+        // память индекса прошлого формата возвращается системе, иначе новый индекс займёт её, не увеличив resident size
+        malloc_trim(0);
+        const size_t resident_before = GetResidentBytes();
+        SearchServer server(STOP_WORDS, layout);
+        ReportRate(name + " AddDocument"s, texts.size(), MeasureSeconds([&]() {
+            for (int id = 0; id < document_count; ++id) {
+                server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { 1, 2 });
+            }
+            }), "docs"s);
+        // весь индекс, а не только списки: словарь, атрибуты и прямой индекс тоже растут с числом документов
+        cerr << name << " index: "s << postings << " postings, "s
+            << static_cast<double>(GetResidentBytes() - resident_before) / postings << " resident bytes per posting"s << endl;
+        size_t found = 0;
+        ReportRate(name + " FindTopDocuments seq"s, queries.size(), MeasureSeconds([&]() {
+            for (const string& query : queries) {
+                found += server.FindTopDocuments(query).size();
+            }
+            }), "queries"s);
+        ReportRate(name + " FindTopDocuments par"s, queries.size(), MeasureSeconds([&]() {
+            for (const string& query : queries) {
+                found += server.FindTopDocuments(execution::par, query).size();
+            }
+            }), "queries"s);
+        ReportRate(name + " MatchDocument"s, 20000, MeasureSeconds([&]() {
+            for (int i = 0; i < 20000; ++i) {
+                found += get<0>(server.MatchDocument(queries[i % queries.size()], (i * 7919) % document_count)).size();
+            }
+            }), "calls"s);
+        cerr << name << " found "s << found << endl;
+    }
+}
+
+void BenchmarkRetrievalModes(int document_count) {
+    ZipfCorpus corpus(7);
+    SearchServer server(STOP_WORDS);
+    {
+        LOG_DURATION("build index"s);
+        int id = 0;
+        for (const string& text : corpus.MakeDocuments(document_count)) {
+            server.AddDocument(id++, text, DocumentStatus::ACTUAL, { 1, 2 });
+        }
+    }
+    {
+        LOG_DURATION("BuildImpactIndex"s);
+        server.BuildImpactIndex();
+    }
+    const vector<string> queries = corpus.MakeQueries(2000);
+    const pair<RetrievalMode, string> modes[] = { { RetrievalMode::EXHAUSTIVE, "EXHAUSTIVE"s }, { RetrievalMode::MAX_SCORE, "MAX_SCORE"s },
+        { RetrievalMode::BLOCK_MAX, "BLOCK_MAX"s }, { RetrievalMode::IMPACT, "IMPACT"s } };
+    for (const size_t count : { 5, 100 }) {
+        for (const auto& [mode, name] : modes) {
+            size_t found = 0;
+            ReportRate(name + " top "s + to_string(count), queries.size(), MeasureSeconds([&]() {
+                for (const string& query : queries) {
+                    found += server.FindTopDocuments(query, DocumentStatus::ACTUAL, count, 0, mode).size();
+                }
+                }), "queries"s);
+        }
+    }
+}
+
+void BenchmarkPostingKernels() {
+    mt19937 generator(3);
+    // блок списка из 128 номеров и его разности
+    vector<int> block(128);
+    for (int value = 0, i = 0; i < 128; ++i) {
+        block[i] = value += 1 + generator() % 20;
+    }
+    vector<uint32_t> gaps(127);
+    for (uint32_t& gap : gaps) {
+        gap = generator() % 20;
+    }
+    // длинный список и удаляемые из него номера
+    vector<int> postings(1 << 20);
+    for (int value = 0, i = 0; i < static_cast<int>(postings.size()); ++i) {
+        postings[i] = value += 1 + generator() % 4;
+    }
+    vector<int> removed;
+    for (int i = 0; i < 20000; ++i) {
+        removed.push_back(postings[generator() % postings.size()]);
+    }
+    sort(removed.begin(), removed.end());
+    removed.erase(unique(removed.begin(), removed.end()), removed.end());
+    // слова запроса и слова документа
+    vector<uint32_t> query_terms = { 5, 17, 90, 400, 1000 };
+    vector<uint32_t> document_terms(24);
+    for (uint32_t value = 0, i = 0; i < document_terms.size(); ++i) {
+        document_terms[i] = value += 1 + generator() % 80;
+    }
+
+    vector<int> ids(128);
+    vector<uint32_t> positions(postings.size());
+    vector<uint32_t> matched(query_terms.size());
+    const pair<SimdLevel, string> levels[] = { { SimdLevel::SCALAR, "scalar"s }, { SimdLevel::SSE4, "SSE4"s }, { SimdLevel::AVX2, "AVX2"s } };
+    const SimdLevel detected = GetSimdLevel();
+    for (const auto& [level, name] : levels) {
+        SetSimdLevel(level);
+        if (GetSimdLevel() != level) {
+            continue;
+        }
+        size_t sink = 0;
+        const int repeat_count = 2000000;
+        ReportRate(name + " CountLess(128)"s, repeat_count, MeasureSeconds([&]() {
+            for (int i = 0; i < repeat_count; ++i) {
+                sink += CountLess(block.data(), block.size(), block[i & 127]);
+            }
+            }), "calls"s);
+        ReportRate(name + " PrefixSumGaps(127)"s, repeat_count, MeasureSeconds([&]() {
+            for (int i = 0; i < repeat_count; ++i) {
+                PrefixSumGaps(i, gaps.data(), gaps.size(), ids.data());
+                sink += ids.back();
+            }
+            }), "calls"s);
+        ReportRate(name + " DifferencePositions(1M, 20k)"s, 100, MeasureSeconds([&]() {
+            for (int i = 0; i < 100; ++i) {
+                sink += DifferencePositions(postings.data(), postings.size(), removed.data(), removed.size(), positions.data());
+            }
+            }), "calls"s);
+        ReportRate(name + " IntersectSorted(5, 24)"s, repeat_count, MeasureSeconds([&]() {
+            for (int i = 0; i < repeat_count; ++i) {
+                query_terms[0] = i & 63;
+                sink += IntersectSorted(query_terms.data(), query_terms.size(), document_terms.data(), document_terms.size(), matched.data());
+            }
+            }), "calls"s);
+        cerr << name << " sink "s << sink << endl;
+    }
+    SetSimdLevel(detected);
+}
+
+void BenchmarkChurn(int round_count, int batch_size) {
+    // в каждом раунде добавляется пакет документов, а пакет четырёхраундовой давности удаляется;
+    // треть слов принадлежит только своему раунду и уходит из словаря вместе с ним
+    const int live_batch_count = 4;
+    mt19937 generator(3);
+    SearchServer server(STOP_WORDS);
+    int next_id = 0;
+    for (int round = 0; round < round_count; ++round) {
+        vector<string> texts(batch_size);
+        for (string& text : texts) {
+            const int length = 3 + generator() % 20;
+            for (int i = 0; i < length; ++i) {
+                text += generator() % 3 != 0 ? "w"s + to_string(generator() % 3000) : "r"s + to_string(round) + "x"s + to_string(generator() % 20000);
+                text += ' ';
+            }
+        }
+        for (const string& text : texts) {
+            server.AddDocument(next_id++, text, DocumentStatus::ACTUAL, { 1 });
+        }
+        if (round >= live_batch_count) {
+            const int first_removed = (round - live_batch_count) * batch_size;
+            if (round % 2 == 0) {
+                vector<int> removed_ids(batch_size);
+                iota(removed_ids.begin(), removed_ids.end(), first_removed);
+                server.RemoveDocuments(removed_ids);
+            }
+            else {
+                for (int id = first_removed; id < first_removed + batch_size; ++id) {
+                    server.RemoveDocument(id);
+                }
+                server.Compact();
+            }
+        }
+        if (round % 5 == 4) {
+            cerr << "round "s << round + 1 << ": "s << server.GetDocumentCount() << " documents, resident "s
+                << (GetResidentBytes() >> 20) << " MB"s << endl;
+        }
+    }
+}
+
+void BenchmarkWalSyncPolicies(int document_count) {
+    ZipfCorpus corpus(7);
+    const vector<string> texts = corpus.MakeDocuments(document_count);
+    const string directory = (filesystem::temp_directory_path() / "benchmark_wal"s).string();
+    {
+        SearchServer server(STOP_WORDS);
+        ReportRate("SearchServer without log"s, texts.size(), MeasureSeconds([&]() {
+            for (int id = 0; id < document_count; ++id) {
+                server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { 1, 2 });
+            }
+            }), "docs"s);
+    }
+    // с ALWAYS каждый вызов ждёт fsync, поэтому документов меньше, а потоки делят fsync между собой
+    const auto run = [&](const string& name, WalSyncPolicy policy, int count, int thread_count) {
+        filesystem::remove_all(directory);
+        DurabilityOptions options;
+        options.sync_policy = policy;
+        DurableSearchServer server(directory, STOP_WORDS, options);
+        ReportRate(name, count, MeasureSeconds([&]() {
+            vector<thread> writers;
+            for (int writer = 0; writer < thread_count; ++writer) {
+                writers.emplace_back([&, writer]() {
+                    for (int id = writer; id < count; id += thread_count) {
+                        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { 1, 2 });
+                    }
+                    });
+            }
+            for (thread& writer : writers) {
+                writer.join();
+            }
+            server.Sync();
+            }), "docs"s);
+    };
+    run("NONE"s, WalSyncPolicy::NONE, document_count, 1);
+    run("PERIODIC"s, WalSyncPolicy::PERIODIC, document_count, 1);
+    run("ALWAYS, 1 thread"s, WalSyncPolicy::ALWAYS, min(document_count, 5000), 1);
+    run("ALWAYS, 8 threads"s, WalSyncPolicy::ALWAYS, min(document_count, 20000), 8);
+    {
+        LOG_DURATION("recovery of the last run from log"s);
+        DurableSearchServer server(directory, STOP_WORDS);
+    }
+    filesystem::remove_all(directory);
+}
+
+void BenchmarkMixedReadWrite(int reader_count, double seconds) {
+    ZipfCorpus corpus(7);
+    const int preload_count = 100000;
+    const vector<string> texts = corpus.MakeDocuments(preload_count + 400000);
+    const vector<string> queries = corpus.MakeQueries(2000);
+    vector<NewDocument> preload;
+    for (int id = 0; id < preload_count; ++id) {
+        preload.push_back({ id, texts[id], DocumentStatus::ACTUAL, { 1, 2 } });
+    }
+    {
+        SearchServer server(STOP_WORDS);
+        server.AddDocuments(preload);
+        WriterPriorityMutex mutex;
+        RunMixedWorkload("SearchServer + shared_mutex"s, texts, preload_count, queries, reader_count, seconds,
+            [&](int id, string_view text) {
+                lock_guard lock(mutex);
+                server.AddDocument(id, text, DocumentStatus::ACTUAL, { 1, 2 });
+            },
+            [&](int id) {
+                lock_guard lock(mutex);
+                server.RemoveDocument(id);
+            },
+            [&](string_view query) {
+                shared_lock lock(mutex);
+                return server.FindTopDocuments(query);
+            });
+    }
+    {
+        SegmentedSearchServer server(STOP_WORDS);
+        server.AddDocuments(preload);
+        server.WaitForMerges();
+        RunMixedWorkload("SegmentedSearchServer"s, texts, preload_count, queries, reader_count, seconds,
+            [&](int id, string_view text) {
+                server.AddDocument(id, text, DocumentStatus::ACTUAL, { 1, 2 });
+            },
+            [&](int id) {
+                server.RemoveDocument(id);
+            },
+            [&](string_view query) {
+                return server.FindTopDocuments(query);
+            });
+        cerr << "SegmentedSearchServer segments: "s << server.GetSegmentCount() << endl;
+    }
+}
+
+void RunBenchmarks(string_view name) {
+    const bool all = name == "all"sv;
+    if (all || name == "layouts"sv) {
+        BenchmarkPostingLayouts();
+    }
+    if (all || name == "modes"sv) {
+        BenchmarkRetrievalModes();
+    }
+    if (all || name == "kernels"sv) {
+        BenchmarkPostingKernels();
+    }
+    if (all || name == "churn"sv) {
+        BenchmarkChurn();
+    }
+    if (all || name == "wal"sv) {
+        BenchmarkWalSyncPolicies();
+    }
+    if (all || name == "mixed"sv) {
+        BenchmarkMixedReadWrite();
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string_view>
+
+// бенчмарки на синтетическом корпусе: слова документов и запросов выбираются по закону Ципфа
+// из словаря в 50000 слов. время печатается в cerr
+
+// построение индекса, память на вхождение и скорость запросов для форматов PLAIN и COMPRESSED
+void BenchmarkPostingLayouts(int document_count = 1000000);
+// EXHAUSTIVE, MAX_SCORE, BLOCK_MAX и IMPACT на одних и тех же запросах
+void BenchmarkRetrievalModes(int document_count = 1000000);
+// каждое ядро posting_kernels.h на всех уровнях SIMD, которые есть у процессора, против скалярной версии
+void BenchmarkPostingKernels();
+// постоянный поток добавлений и удалений со сменой словаря: resident size не должен расти
+void BenchmarkChurn(int round_count = 40, int batch_size = 5000);
+// скорость добавления в DurableSearchServer при каждой политике fsync
+void BenchmarkWalSyncPolicies(int document_count = 200000);
+// SearchServer под shared_mutex против SegmentedSearchServer
+void BenchmarkMixedReadWrite(int reader_count = 2, double seconds = 5.0);
+
+// запускает бенчмарк по имени: layouts, modes, kernels, churn, wal, mixed или all
+void RunBenchmarks(std::string_view name);
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// битовая карта по порядковым номерам документов
+class Bitmap {
+public:
+    Bitmap() = default;
+    // карта из size бит, лежащих в words
+    Bitmap(std::vector<uint64_t> words, size_t size)
+        : words_(std::move(words))
+        , size_(size) {
+    }
+
+    void PushBack(bool value) {
+        if (size_ % 64 == 0) {
+            words_.push_back(0);
+        }
+        if (value) {
+            Set(size_);
+        }
+        ++size_;
+    }
+
+    void Set(size_t index) {
+        words_[index / 64] |= uint64_t{ 1 } << (index % 64);
+    }
+
+    void Reset(size_t index) {
+        words_[index / 64] &= ~(uint64_t{ 1 } << (index % 64));
+    }
+
+    bool Test(size_t index) const {
+        return (words_[index / 64] >> (index % 64)) & 1;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    const std::vector<uint64_t>& Words() const {
+        return words_;
+    }
+
+private:
+    std::vector<uint64_t> words_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,408 @@
+#include "compressed_posting_list.h"
+#include "posting_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+uint8_t BitWidth(uint32_t value) {
+    uint8_t bits = 0;
+    while (value != 0) {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+size_t PackedWordCount(size_t count, uint8_t delta_bits, uint8_t count_bits) {
+    if (count == 0) {
+        return 0;
+    }
+    const size_t bit_count = (count - 1) * delta_bits + count * count_bits;
+    return (bit_count + 63) / 64;
+}
+
+// words должны быть обнулены
+void WriteBits(uint64_t* words, size_t bit_pos, uint8_t bits, uint32_t value) {
+    if (bits == 0) {
+        return;
+    }
+    const size_t word = bit_pos / 64;
+    const size_t shift = bit_pos % 64;
+    words[word] |= static_cast<uint64_t>(value) << shift;
+    if (shift + bits > 64) {
+        words[word + 1] |= static_cast<uint64_t>(value) >> (64 - shift);
+    }
+}
+
+// читает 8 байт с байта, в котором начинается значение, поэтому за данными держится слово запаса
+uint32_t ReadBits(const uint64_t* words, size_t bit_pos, uint64_t mask) {
+    uint64_t value;
+    memcpy(&value, reinterpret_cast<const char*>(words) + bit_pos / 8, sizeof(value));
+    return static_cast<uint32_t>((value >> (bit_pos % 8)) & mask);
+}
+
+} // namespace
+
+void CompressedPostingList::Add(int document_id, double term_freq) {
+    if (!tail_ids_.empty() && tail_ids_.back() == document_id) {
+        ++tail_counts_.Mutable().back();
+        last_term_freq_ += term_freq;
+        tail_max_term_freq_ = max(tail_max_term_freq_, last_term_freq_);
+        max_term_freq_ = max(max_term_freq_, last_term_freq_);
+        return;
+    }
+    if (size_ > 0 && document_id <= BlockLastId(BlockCount() - 1)) {
+        throw invalid_argument("Document "s + to_string(document_id) + " is out of order"s);
+    }
+    // хвост сжимаем только при появлении следующего документа: последний документ ещё может получить вхождения
+    if (tail_ids_.size() == BLOCK_SIZE) {
+        SealTail();
+    }
+    tail_ids_.Mutable().push_back(document_id);
+    tail_counts_.Mutable().push_back(1);
+    last_term_freq_ = term_freq;
+    tail_max_term_freq_ = max(tail_max_term_freq_, term_freq);
+    max_term_freq_ = max(max_term_freq_, term_freq);
+    ++size_;
+    ++document_freq_;
+    UpdateLogDocumentFreq();
+}
+
+void CompressedPostingList::MarkRemoved(size_t document_count) {
+    document_freq_ -= document_count;
+    UpdateLogDocumentFreq();
+}
+
+template <typename NewOrdinal>
+void CompressedPostingList::Rebuild(NewOrdinal new_ordinal) {
+    // вхождения складываем в новый список полными блоками. частоты в списке не восстановить без весов
+    // документов, поэтому оценкой блока берётся наибольшая оценка исходных блоков, из которых он собран
+    CompressedPostingList result;
+    result.max_term_freq_ = max_term_freq_;
+    int ids[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    for (size_t block = 0; block < BlockCount(); ++block) {
+        const size_t count = DecodeBlock(block, ids, counts);
+        const double block_max_term_freq = BlockMaxTermFreq(block);
+        for (size_t i = 0; i < count; ++i) {
+            const int ordinal = new_ordinal(ids[i]);
+            if (ordinal < 0) {
+                continue;
+            }
+            if (result.tail_ids_.size() == BLOCK_SIZE) {
+                result.SealTail();
+            }
+            result.tail_ids_.Mutable().push_back(ordinal);
+            result.tail_counts_.Mutable().push_back(counts[i]);
+            result.tail_max_term_freq_ = max(result.tail_max_term_freq_, block_max_term_freq);
+            ++result.size_;
+        }
+    }
+    if (result.size_ == 0) {
+        result.max_term_freq_ = 0.0;
+    }
+    result.document_freq_ = result.size_;
+    result.UpdateLogDocumentFreq();
+    result.words_.Mutable().shrink_to_fit();
+    result.blocks_.Mutable().shrink_to_fit();
+    *this = move(result);
+}
+
+void CompressedPostingList::EraseDocuments(const Bitmap& removed) {
+    if (size_ == document_freq_) {
+        return;
+    }
+    Rebuild([&removed](int ordinal) {
+        return removed.Test(ordinal) ? -1 : ordinal;
+        });
+}
+
+void CompressedPostingList::Renumber(const vector<int>& new_ordinals) {
+    // разности между номерами уменьшаются, поэтому блоки перепаковываются
+    Rebuild([&new_ordinals](int ordinal) {
+        return new_ordinals[ordinal];
+        });
+}
+
+bool CompressedPostingList::Contains(int document_id) const {
+    const size_t block = FindBlock(document_id, 0);
+    if (block == blocks_.size()) {
+        return binary_search(tail_ids_.begin(), tail_ids_.end(), document_id);
+    }
+    if (document_id < blocks_[block].first_id) {
+        return false;
+    }
+    int ids[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    const size_t count = DecodeBlock(block, ids, counts);
+    const size_t pos = CountLess(ids, count, document_id);
+    return pos < count && ids[pos] == document_id;
+}
+
+CompressedPostingList::SnapshotEntry CompressedPostingList::Save(SnapshotWriter& writer) const {
+    return { writer.Write(blocks_), writer.Write(words_), writer.Write(tail_ids_), writer.Write(tail_counts_),
+        tail_max_term_freq_, last_term_freq_, size_, document_freq_, max_term_freq_ };
+}
+
+void CompressedPostingList::Load(const SnapshotReader& reader, const SnapshotEntry& entry, size_t ordinal_count) {
+    blocks_ = reader.Array<Block>(entry.blocks);
+    words_ = reader.Array<uint64_t>(entry.words);
+    tail_ids_ = reader.Array<int>(entry.tail_ids);
+    tail_counts_ = reader.Array<uint32_t>(entry.tail_counts);
+    const auto is_term_freq = [&entry](double term_freq) {
+        return term_freq >= 0.0 && term_freq <= entry.max_term_freq;
+    };
+    if (tail_counts_.size() != tail_ids_.size() || tail_ids_.size() > BLOCK_SIZE || entry.document_freq > entry.size
+        || !(entry.max_term_freq >= 0.0 && entry.max_term_freq <= numeric_limits<double>::max())
+        || !is_term_freq(entry.tail_max_term_freq) || !is_term_freq(entry.last_term_freq)) {
+        throw runtime_error("Snapshot file is damaged"s);
+    }
+    // номера внутри блока распаковываются только в Check, здесь проверяется, что они помещаются
+    // между первым и последним номером, а блоки идут по возрастанию и не выходят за число документов
+    int64_t previous_id = -1;
+    uint64_t size = tail_ids_.size();
+    for (const Block& block : blocks_) {
+        if (block.count == 0 || block.count > BLOCK_SIZE || block.delta_bits > 32 || block.count_bits > 32
+            || block.first_id <= previous_id || block.last_id < block.first_id
+            || static_cast<size_t>(block.last_id) >= ordinal_count
+            || static_cast<int64_t>(block.last_id) - block.first_id < block.count - 1
+            || !(block.max_term_freq > 0.0 && is_term_freq(block.max_term_freq))) {
+            throw runtime_error("Snapshot file is damaged"s);
+        }
+        // за упакованными данными блока должно оставаться слово запаса
+        const size_t word_count = PackedWordCount(block.count, block.delta_bits, block.count_bits);
+        if (word_count > 0 && block.offset + word_count >= words_.size()) {
+            throw runtime_error("Snapshot file is damaged"s);
+        }
+        previous_id = block.last_id;
+        size += block.count;
+    }
+    for (size_t i = 0; i < tail_ids_.size(); ++i) {
+        if (tail_ids_[i] <= previous_id || static_cast<size_t>(tail_ids_[i]) >= ordinal_count || tail_counts_[i] == 0) {
+            throw runtime_error("Snapshot file is damaged"s);
+        }
+        previous_id = tail_ids_[i];
+    }
+    if (size != entry.size) {
+        throw runtime_error("Snapshot file is damaged"s);
+    }
+    tail_max_term_freq_ = entry.tail_max_term_freq;
+    last_term_freq_ = entry.last_term_freq;
+    size_ = entry.size;
+    document_freq_ = entry.document_freq;
+    max_term_freq_ = entry.max_term_freq;
+    UpdateLogDocumentFreq();
+}
+
+void CompressedPostingList::Check(const MappedArray<double>& word_weights) const {
+    // разности читаются напрямую и складываются в 64 бита: повреждённые разности не должны переполнять номер
+    for (const Block& block : blocks_) {
+        const uint64_t* words = words_.data() + block.offset;
+        size_t bit_pos = 0;
+        int64_t id = block.first_id;
+        if (block.delta_bits > 0) {
+            const uint64_t mask = (uint64_t{ 1 } << block.delta_bits) - 1;
+            for (size_t i = 0; i + 1 < block.count && id <= block.last_id; ++i, bit_pos += block.delta_bits) {
+                id += static_cast<int64_t>(ReadBits(words, bit_pos, mask)) + 1;
+            }
+        }
+        else {
+            id += block.count - 1;
+        }
+        if (id != block.last_id) {
+            throw runtime_error("Snapshot file is damaged"s);
+        }
+    }
+    int ids[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    for (size_t block = 0; block < BlockCount(); ++block) {
+        const size_t count = DecodeBlock(block, ids, counts);
+        for (size_t i = 0; i < count; ++i) {
+            const double term_freq = counts[i] * word_weights[ids[i]];
+            if (!(term_freq > 0.0 && term_freq <= BlockMaxTermFreq(block))) {
+                throw runtime_error("Snapshot file is damaged"s);
+            }
+        }
+    }
+}
+
+size_t CompressedPostingList::size() const {
+    return size_;
+}
+
+bool CompressedPostingList::empty() const {
+    return size_ == 0;
+}
+
+size_t CompressedPostingList::FindBlock(int document_id, size_t first_block) const {
+    return lower_bound(blocks_.begin() + min(first_block, blocks_.size()), blocks_.end(), document_id,
+        [](const Block& block, int id) {
+            return block.last_id < id;
+        }) - blocks_.begin();
+}
+
+size_t CompressedPostingList::BlockCount() const {
+    return blocks_.size() + (tail_ids_.empty() ? 0 : 1);
+}
+
+int CompressedPostingList::BlockLastId(size_t block) const {
+    return block < blocks_.size() ? blocks_[block].last_id : tail_ids_.back();
+}
+
+double CompressedPostingList::BlockMaxTermFreq(size_t block) const {
+    return block < blocks_.size() ? blocks_[block].max_term_freq : tail_max_term_freq_;
+}
+
+size_t CompressedPostingList::DecodeBlock(size_t block, int* ids, uint32_t* counts) const {
+    if (block == blocks_.size()) {
+        copy(tail_ids_.begin(), tail_ids_.end(), ids);
+        copy(tail_counts_.begin(), tail_counts_.end(), counts);
+        return tail_ids_.size();
+    }
+    const Block& header = blocks_[block];
+    const uint64_t* words = words_.data() + header.offset;
+    size_t bit_pos = 0;
+    // разности распаковываем отдельно, а номера из них собираем векторной префиксной суммой
+    uint32_t gaps[BLOCK_SIZE];
+    if (header.delta_bits == 0) {
+        fill(gaps, gaps + header.count - 1, 0u);
+    }
+    else {
+        const uint64_t mask = (uint64_t{ 1 } << header.delta_bits) - 1;
+        for (size_t i = 0; i + 1 < header.count; ++i, bit_pos += header.delta_bits) {
+            gaps[i] = ReadBits(words, bit_pos, mask);
+        }
+    }
+    PrefixSumGaps(header.first_id, gaps, header.count - 1u, ids);
+    if (header.count_bits == 0) {
+        fill(counts, counts + header.count, 1u);
+    }
+    else {
+        const uint64_t mask = (uint64_t{ 1 } << header.count_bits) - 1;
+        for (size_t i = 0; i < header.count; ++i, bit_pos += header.count_bits) {
+            counts[i] = ReadBits(words, bit_pos, mask) + 1;
+        }
+    }
+    return header.count;
+}
+
+void CompressedPostingList::EncodeBlock(const int* ids, const uint32_t* counts, size_t count, Block& block) {
+    uint32_t max_delta = 0;
+    uint32_t max_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            max_delta = max(max_delta, static_cast<uint32_t>(ids[i] - ids[i - 1] - 1));
+        }
+        max_count = max(max_count, counts[i] - 1);
+    }
+    const size_t old_word_count = PackedWordCount(block.count, block.delta_bits, block.count_bits);
+    block.first_id = ids[0];
+    block.last_id = ids[count - 1];
+    block.count = static_cast<uint8_t>(count);
+    block.delta_bits = BitWidth(max_delta);
+    block.count_bits = BitWidth(max_count);
+    const size_t word_count = PackedWordCount(count, block.delta_bits, block.count_bits);
+    vector<uint64_t>& packed_words = words_.Mutable();
+    if (word_count > old_word_count) {
+        // новые данные пишутся на место слова запаса, за ними добавляется новое
+        block.offset = static_cast<uint32_t>(packed_words.empty() ? 0 : packed_words.size() - 1);
+        packed_words.resize(block.offset + word_count + 1);
+    }
+    uint64_t* words = packed_words.data() + block.offset;
+    fill(words, words + word_count, uint64_t{ 0 });
+    size_t bit_pos = 0;
+    for (size_t i = 1; i < count; ++i, bit_pos += block.delta_bits) {
+        WriteBits(words, bit_pos, block.delta_bits, static_cast<uint32_t>(ids[i] - ids[i - 1] - 1));
+    }
+    for (size_t i = 0; i < count; ++i, bit_pos += block.count_bits) {
+        WriteBits(words, bit_pos, block.count_bits, counts[i] - 1);
+    }
+}
+
+void CompressedPostingList::SealTail() {
+    Block block{};
+    EncodeBlock(tail_ids_.data(), tail_counts_.data(), tail_ids_.size(), block);
+    block.max_term_freq = tail_max_term_freq_;
+    blocks_.Mutable().push_back(block);
+    tail_ids_.Mutable().clear();
+    tail_counts_.Mutable().clear();
+    tail_max_term_freq_ = 0.0;
+}
+
+void CompressedPostingList::UpdateLogDocumentFreq() {
+    log_document_freq_ = log(static_cast<double>(document_freq_));
+}
+
+CompressedPostingList::Cursor::Cursor(const CompressedPostingList& postings, const MappedArray<double>& word_weights,
+    int first_ordinal, int last_ordinal)
+    : postings_(&postings)
+    , word_weights_(word_weights.data())
+    , last_ordinal_(last_ordinal) {
+    LoadBlock(postings.FindBlock(first_ordinal, 0));
+    shallow_block_ = block_;
+    Seek(first_ordinal);
+}
+
+void CompressedPostingList::Cursor::Seek(int ordinal) {
+    if (at_end_ || ids_[index_] >= ordinal) {
+        return;
+    }
+    if (ids_[count_ - 1] < ordinal) {
+        LoadBlock(postings_->FindBlock(ordinal, block_ + 1));
+        if (at_end_) {
+            return;
+        }
+    }
+    index_ += CountLess(ids_.data() + index_, count_ - index_, ordinal);
+    at_end_ = index_ == count_ || ids_[index_] >= last_ordinal_;
+}
+
+size_t CompressedPostingList::Cursor::ChunkSize() const {
+    if (ids_[count_ - 1] < last_ordinal_) {
+        return count_ - index_;
+    }
+    return CountLess(ids_.data() + index_, count_ - index_, last_ordinal_);
+}
+
+void CompressedPostingList::Cursor::NextChunk() {
+    if (ids_[count_ - 1] >= last_ordinal_) {
+        at_end_ = true;
+        return;
+    }
+    LoadBlock(block_ + 1);
+}
+
+bool CompressedPostingList::Cursor::SeekBlock(int ordinal) {
+    const size_t block_count = postings_->BlockCount();
+    while (shallow_block_ < block_count && postings_->BlockLastId(shallow_block_) < ordinal) {
+        ++shallow_block_;
+    }
+    return shallow_block_ < block_count;
+}
+
+int CompressedPostingList::Cursor::BlockLastOrdinal() const {
+    return postings_->BlockLastId(shallow_block_);
+}
+
+double CompressedPostingList::Cursor::BlockMaxTermFreq() const {
+    return postings_->BlockMaxTermFreq(shallow_block_);
+}
+
+void CompressedPostingList::Cursor::LoadBlock(size_t block) {
+    block_ = block;
+    index_ = 0;
+    if (block >= postings_->BlockCount()) {
+        count_ = 0;
+        at_end_ = true;
+        return;
+    }
+    count_ = postings_->DecodeBlock(block, ids_.data(), counts_.data());
+    at_end_ = ids_[0] >= last_ordinal_;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bitmap.h"
+#include "mapped_array.h"
+#include "snapshot_file.h"
+
+// сжатый список вхождений слова. номера документов лежат блоками по BLOCK_SIZE: первый номер хранится
+// в описании блока, остальные - разностями с предыдущим, упакованными минимальным числом бит.
+// вместо частоты хранится число вхождений слова, частота восстанавливается умножением на вес
+// одного слова документа (1 / число слов). последний неполный блок хранится несжатым
+class CompressedPostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // описание списка в снимке индекса
+    struct SnapshotEntry {
+        SnapshotArray blocks;
+        SnapshotArray words;
+        SnapshotArray tail_ids;
+        SnapshotArray tail_counts;
+        double tail_max_term_freq;
+        double last_term_freq;
+        uint64_t size;
+        uint64_t document_freq;
+        double max_term_freq;
+    };
+
+    // добавляет частоту к документу; документы добавляются по возрастанию номера,
+    // повторно можно добавлять только последний документ
+    void Add(int document_id, double term_freq);
+    // document_count документов из списка удалены, но их вхождения остаются в списке до EraseDocuments:
+    // уменьшается только число документов со словом, по которому считается IDF
+    void MarkRemoved(size_t document_count = 1);
+    // убирает из списка вхождения документов, отмеченных в removed, и переупаковывает оставшиеся
+    void EraseDocuments(const Bitmap& removed);
+    // переводит номера документов в new_ordinals[номер]; удалённых документов в списке быть не должно,
+    // новые номера должны сохранять порядок
+    void Renumber(const std::vector<int>& new_ordinals);
+    bool Contains(int document_id) const;
+
+    SnapshotEntry Save(SnapshotWriter& writer) const;
+    // заменяет список сохранённым в снимке, массивы смотрят в страницы снимка. проверяются описания блоков
+    // и несжатый хвост: номера должны расти и быть меньше ordinal_count
+    void Load(const SnapshotReader& reader, const SnapshotEntry& entry, size_t ordinal_count);
+    // распаковывает блоки списка из снимка и бросает runtime_error, если номера не сходятся с описаниями блоков
+    // или частота вхождения больше оценки блока
+    void Check(const MappedArray<double>& word_weights) const;
+
+    // число вхождений в списке, вместе с ещё не убранными удалёнными документами
+    size_t size() const;
+    bool empty() const;
+    // число неудалённых документов со словом
+    size_t DocumentFreq() const {
+        return document_freq_;
+    }
+
+    double LogDocumentFreq() const {
+        return log_document_freq_;
+    }
+    // верхняя оценка частоты слова: при удалении документов не уменьшается
+    double MaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    // курсор по вхождениям с номерами из [first_ordinal, last_ordinal), распаковывает по блоку за раз
+    class Cursor {
+    public:
+        Cursor(const CompressedPostingList& postings, const MappedArray<double>& word_weights,
+            int first_ordinal, int last_ordinal);
+
+        bool AtEnd() const {
+            return at_end_;
+        }
+        int Ordinal() const {
+            return ids_[index_];
+        }
+        double TermFreq() const {
+            return counts_[index_] * word_weights_[ids_[index_]];
+        }
+        void Next() {
+            if (++index_ == count_) {
+                LoadBlock(block_ + 1);
+            }
+            else {
+                at_end_ = ids_[index_] >= last_ordinal_;
+            }
+        }
+        // переходит к первому вхождению с номером не меньше ordinal
+        void Seek(int ordinal);
+
+        // вхождения читаются кусками: у сжатого списка кусок - остаток распакованного блока
+        const int* ChunkOrdinals() const {
+            return ids_.data() + index_;
+        }
+        size_t ChunkSize() const;
+        double ChunkTermFreq(size_t i) const {
+            return counts_[index_ + i] * word_weights_[ids_[index_ + i]];
+        }
+        void NextChunk();
+
+        // переходит к блоку, в который попал бы ordinal, false если таких блоков нет;
+        // позиция курсора при этом не меняется
+        bool SeekBlock(int ordinal);
+        int BlockLastOrdinal() const;
+        double BlockMaxTermFreq() const;
+
+    private:
+        void LoadBlock(size_t block);
+
+        const CompressedPostingList* postings_;
+        const double* word_weights_;
+        int last_ordinal_;
+        bool at_end_ = false;
+        size_t block_ = 0;
+        size_t count_ = 0;
+        size_t index_ = 0;
+        size_t shallow_block_ = 0;
+        std::array<int, BLOCK_SIZE> ids_;
+        std::array<uint32_t, BLOCK_SIZE> counts_;
+    };
+
+private:
+    struct Block {
+        int first_id;
+        int last_id;
+        uint32_t offset; // начало упакованных данных в words_
+        uint8_t count;
+        uint8_t delta_bits;
+        uint8_t count_bits;
+        double max_term_freq;
+    };
+
+    // номер блока не раньше first_block, в который попал бы document_id; blocks_.size() означает несжатый хвост
+    size_t FindBlock(int document_id, size_t first_block) const;
+    size_t BlockCount() const;
+    int BlockLastId(size_t block) const;
+    double BlockMaxTermFreq(size_t block) const;
+    // распаковывает блок (или копирует хвост), возвращает число вхождений
+    size_t DecodeBlock(size_t block, int* ids, uint32_t* counts) const;
+    // упаковывает вхождения в блок, данные пишутся на старое место, если помещаются
+    void EncodeBlock(const int* ids, const uint32_t* counts, size_t count, Block& block);
+    // сжимает полный хвост в новый блок
+    void SealTail();
+    // собирает список заново из вхождений с номерами new_ordinal(номер), отрицательный номер выбрасывает вхождение
+    template <typename NewOrdinal>
+    void Rebuild(NewOrdinal new_ordinal);
+    void UpdateLogDocumentFreq();
+
+    MappedArray<Block> blocks_;
+    MappedArray<uint64_t> words_;
+    MappedArray<int> tail_ids_;
+    MappedArray<uint32_t> tail_counts_;
+    double tail_max_term_freq_ = 0.0;
+    double last_term_freq_ = 0.0;
+    size_t size_ = 0;
+    size_t document_freq_ = 0;
+    double log_document_freq_ = 0.0;
+    double max_term_freq_ = 0.0;
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 
 enum class DocumentStatus {
     ACTUAL,
@@ -7,6 +8,8 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
 struct Document {
     Document() = default;
     Document(int id, double relevance, int rating);
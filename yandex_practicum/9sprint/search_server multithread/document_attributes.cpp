@@ -0,0 +1,165 @@
+#include "document_attributes.h"
+#include <stdexcept>
+
+DocumentAttributes::DocumentAttributes(bool keep_texts)
+    : keep_texts_(keep_texts) {
+}
+
+int DocumentAttributes::Add(int document_id, int rating, DocumentStatus status, double word_weight, std::string_view text) {
+    const int ordinal = static_cast<int>(ids_.size());
+    ids_.Mutable().push_back(document_id);
+    ratings_.Mutable().push_back(rating);
+    word_weights_.Mutable().push_back(word_weight);
+    if (keep_texts_) {
+        texts_.emplace_back(text);
+    }
+    for (size_t i = 0; i < status_bitmaps_.size(); ++i) {
+        status_bitmaps_[i].PushBack(i == static_cast<size_t>(status));
+    }
+    removed_.PushBack(false);
+    return ordinal;
+}
+
+void DocumentAttributes::Remove(int ordinal) {
+    for (auto& status_bitmap : status_bitmaps_) {
+        status_bitmap.Reset(ordinal);
+    }
+    removed_.Set(ordinal);
+    if (keep_texts_) {
+        std::string().swap(texts_[ordinal]);
+    }
+    ++removed_count_;
+}
+
+std::vector<int> DocumentAttributes::Compact() {
+    std::vector<int>& ids = ids_.Mutable();
+    std::vector<int>& ratings = ratings_.Mutable();
+    std::vector<double>& word_weights = word_weights_.Mutable();
+    std::vector<int> new_ordinals(ids.size(), -1);
+    std::array<Bitmap, DOCUMENT_STATUS_COUNT> status_bitmaps;
+    int kept = 0;
+    for (int ordinal = 0; ordinal < static_cast<int>(ids.size()); ++ordinal) {
+        if (removed_.Test(ordinal)) {
+            continue;
+        }
+        new_ordinals[ordinal] = kept;
+        ids[kept] = ids[ordinal];
+        ratings[kept] = ratings[ordinal];
+        word_weights[kept] = word_weights[ordinal];
+        if (keep_texts_) {
+            texts_[kept] = std::move(texts_[ordinal]);
+        }
+        for (size_t i = 0; i < status_bitmaps.size(); ++i) {
+            status_bitmaps[i].PushBack(status_bitmaps_[i].Test(ordinal));
+        }
+        ++kept;
+    }
+    ids.resize(kept);
+    ratings.resize(kept);
+    word_weights.resize(kept);
+    if (keep_texts_) {
+        texts_.resize(kept);
+    }
+    ids.shrink_to_fit();
+    ratings.shrink_to_fit();
+    word_weights.shrink_to_fit();
+    texts_.shrink_to_fit();
+    status_bitmaps_ = std::move(status_bitmaps);
+    removed_ = Bitmap();
+    for (int i = 0; i < kept; ++i) {
+        removed_.PushBack(false);
+    }
+    removed_count_ = 0;
+    return new_ordinals;
+}
+
+DocumentAttributes::SnapshotEntry DocumentAttributes::Save(SnapshotWriter& writer) const {
+    SnapshotEntry entry{};
+    entry.ids = writer.Write(ids_);
+    entry.ratings = writer.Write(ratings_);
+    entry.word_weights = writer.Write(word_weights_);
+    for (size_t i = 0; i < status_bitmaps_.size(); ++i) {
+        entry.status_words[i] = writer.Write(status_bitmaps_[i].Words());
+    }
+    entry.removed_words = writer.Write(removed_.Words());
+    entry.texts = writer.WriteStrings(texts_);
+    entry.removed_count = removed_count_;
+    entry.has_texts = keep_texts_;
+    return entry;
+}
+
+void DocumentAttributes::Load(const SnapshotReader& reader, const SnapshotEntry& entry) {
+    ids_ = reader.Array<int>(entry.ids);
+    ratings_ = reader.Array<int>(entry.ratings);
+    word_weights_ = reader.Array<double>(entry.word_weights);
+    const size_t size = ids_.size();
+    const size_t word_count = (size + 63) / 64;
+    if (ratings_.size() != size || word_weights_.size() != size || entry.removed_words.size != word_count) {
+        throw std::runtime_error("Snapshot file is damaged");
+    }
+    for (size_t i = 0; i < status_bitmaps_.size(); ++i) {
+        const MappedArray<uint64_t> words = reader.Array<uint64_t>(entry.status_words[i]);
+        if (words.size() != word_count) {
+            throw std::runtime_error("Snapshot file is damaged");
+        }
+        status_bitmaps_[i] = Bitmap(std::vector<uint64_t>(words.begin(), words.end()), size);
+    }
+    const MappedArray<uint64_t> removed_words = reader.Array<uint64_t>(entry.removed_words);
+    removed_ = Bitmap(std::vector<uint64_t>(removed_words.begin(), removed_words.end()), size);
+    removed_count_ = entry.removed_count;
+    // у живого документа ровно один статус, у удалённого ни одного, биты за концом карт не заняты
+    size_t removed_count = 0;
+    for (size_t word = 0; word < word_count; ++word) {
+        const uint64_t used = word + 1 < word_count || size % 64 == 0 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << (size % 64)) - 1;
+        uint64_t statuses = 0;
+        for (const Bitmap& status_bitmap : status_bitmaps_) {
+            const uint64_t status_word = status_bitmap.Words()[word];
+            if ((statuses & status_word) != 0) {
+                throw std::runtime_error("Snapshot file is damaged");
+            }
+            statuses |= status_word;
+        }
+        if ((removed_words[word] & ~used) != 0 || statuses != (~removed_words[word] & used)) {
+            throw std::runtime_error("Snapshot file is damaged");
+        }
+        removed_count += static_cast<size_t>(__builtin_popcountll(removed_words[word]));
+    }
+    if (removed_count != removed_count_) {
+        throw std::runtime_error("Snapshot file is damaged");
+    }
+    // у документа без слов вес бесконечный, но в списки вхождений такой документ не попадает
+    for (const double word_weight : word_weights_) {
+        if (!(word_weight > 0.0)) {
+            throw std::runtime_error("Snapshot file is damaged");
+        }
+    }
+    texts_.clear();
+    if (keep_texts_) {
+        if (entry.has_texts) {
+            const std::vector<std::string_view> texts = reader.Strings(entry.texts);
+            texts_.assign(texts.begin(), texts.end());
+        }
+        texts_.resize(size);
+    }
+}
+
+DocumentStatus DocumentAttributes::GetStatus(int ordinal) const {
+    for (size_t i = 0; i < status_bitmaps_.size(); ++i) {
+        if (status_bitmaps_[i].Test(ordinal)) {
+            return static_cast<DocumentStatus>(i);
+        }
+    }
+    return DocumentStatus::REMOVED;
+}
+
+const Bitmap& DocumentAttributes::GetStatusBitmap(DocumentStatus status) const {
+    return status_bitmaps_[static_cast<size_t>(status)];
+}
+
+std::string_view DocumentAttributes::GetText(int ordinal) const {
+    return keep_texts_ ? std::string_view(texts_[ordinal]) : std::string_view();
+}
+
+size_t DocumentAttributes::size() const {
+    return ids_.size();
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bitmap.h"
+#include "document.h"
+#include "mapped_array.h"
+#include "snapshot_file.h"
+
+// атрибуты документов, хранящиеся по столбцам; индекс - порядковый номер документа
+// статус хранится битовыми картами, по одной на каждое значение DocumentStatus.
+// удалённый документ остаётся на своём номере до Compact: его статус сбрасывается, текст освобождается,
+// а номер отмечается в карте удалённых
+class DocumentAttributes {
+public:
+    // без keep_texts тексты документов не хранятся, столбец текстов остаётся пустым
+    explicit DocumentAttributes(bool keep_texts = true);
+
+    // описание атрибутов в снимке индекса
+    struct SnapshotEntry {
+        SnapshotArray ids;
+        SnapshotArray ratings;
+        SnapshotArray word_weights;
+        SnapshotArray status_words[DOCUMENT_STATUS_COUNT];
+        SnapshotArray removed_words;
+        SnapshotStrings texts;
+        uint64_t removed_count;
+        uint64_t has_texts;
+    };
+
+    // добавляет документ и возвращает его порядковый номер
+    int Add(int document_id, int rating, DocumentStatus status, double word_weight, std::string_view text);
+    void Remove(int ordinal);
+    // убирает строки удалённых документов, сдвигая остальные к началу с сохранением порядка;
+    // возвращает новые номера по старым, у удалённых -1
+    std::vector<int> Compact();
+
+    SnapshotEntry Save(SnapshotWriter& writer) const;
+    // заменяет атрибуты сохранёнными в снимке: числовые столбцы смотрят в страницы снимка,
+    // битовые карты и тексты (если они хранятся) копируются
+    void Load(const SnapshotReader& reader, const SnapshotEntry& entry);
+
+    int GetId(int ordinal) const {
+        return ids_[ordinal];
+    }
+    int GetRating(int ordinal) const {
+        return ratings_[ordinal];
+    }
+    // вес одного вхождения слова (1 / число слов документа), по нему сжатые списки восстанавливают частоты
+    const MappedArray<double>& GetWordWeights() const {
+        return word_weights_;
+    }
+    bool IsRemoved(int ordinal) const {
+        return removed_.Test(ordinal);
+    }
+    const Bitmap& GetRemovedBitmap() const {
+        return removed_;
+    }
+    DocumentStatus GetStatus(int ordinal) const;
+    const Bitmap& GetStatusBitmap(DocumentStatus status) const;
+    // пустая строка, если тексты не хранятся
+    std::string_view GetText(int ordinal) const;
+
+    // число номеров вместе с удалёнными
+    size_t size() const;
+    size_t RemovedCount() const {
+        return removed_count_;
+    }
+
+private:
+    MappedArray<int> ids_;
+    MappedArray<int> ratings_;
+    MappedArray<double> word_weights_;
+    bool keep_texts_;
+    std::vector<std::string> texts_;
+    std::array<Bitmap, DOCUMENT_STATUS_COUNT> status_bitmaps_;
+    Bitmap removed_;
+    size_t removed_count_ = 0;
+};
@@ -0,0 +1,309 @@
+#include "durable_search_server.h"
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <execution>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+const string SNAPSHOT_PREFIX = "snapshot."s;
+const string LOG_PREFIX = "wal."s;
+// столько документов из подряд идущих записей добавления повторяются одним AddDocuments
+constexpr size_t REPLAY_BATCH_SIZE = 1 << 16;
+
+// номера файлов вида prefix + число в каталоге по возрастанию
+vector<uint64_t> FindGenerations(const string& directory, const string& prefix) {
+    vector<uint64_t> generations;
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        const string name = entry.path().filename().string();
+        if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0
+            && all_of(name.begin() + prefix.size(), name.end(), [](unsigned char c) { return isdigit(c); })) {
+            generations.push_back(stoull(name.substr(prefix.size())));
+        }
+    }
+    sort(generations.begin(), generations.end());
+    return generations;
+}
+
+uint64_t FindLatestSnapshot(const string& directory) {
+    const vector<uint64_t> generations = FindGenerations(directory, SNAPSHOT_PREFIX);
+    return generations.empty() ? 0 : generations.back();
+}
+
+} // namespace
+
+DurableSearchServer::DurableSearchServer(string directory, string_view stop_words_text, DurabilityOptions options)
+    : directory_(move(directory))
+    , options_(options)
+    , generation_(FindLatestSnapshot(directory_))
+    , server_(generation_ > 0
+        ? SearchServer::OpenSnapshot(SnapshotPath(generation_), options_.text_storage)
+        : SearchServer(stop_words_text, options_.posting_layout, options_.text_storage)) {
+    filesystem::create_directories(directory_);
+    const uint64_t snapshot_generation = generation_;
+    vector<uint64_t> logs = FindGenerations(directory_, LOG_PREFIX);
+    logs.erase(logs.begin(), lower_bound(logs.begin(), logs.end(), snapshot_generation));
+    for (size_t i = 0; i < logs.size(); ++i) {
+        Replay(LogPath(logs[i]), i + 1 == logs.size());
+    }
+    if (!logs.empty()) {
+        generation_ = logs.back();
+    }
+    log_ = make_shared<WriteAheadLog>(LogPath(generation_), options_.sync_policy, options_.sync_interval);
+    SyncPath(directory_);
+    // файлы, оставшиеся от прерванного Checkpoint
+    RemoveFilesBefore(snapshot_generation);
+    error_code error;
+    filesystem::remove(directory_ + "/snapshot.tmp"s, error);
+}
+
+void DurableSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    unique_lock lock(mutex_);
+    WaitForWrite(lock);
+    const vector<NewDocument> documents = { { document_id, document, status, ratings } };
+    CheckNewDocuments(documents);
+    LogAndApply(lock, { document_id }, true,
+        [&documents](WriteAheadLog& log) { return log.AppendAdd(documents); },
+        [&]() { server_.AddDocument(document_id, document, status, ratings); });
+}
+
+void DurableSearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    if (documents.empty()) {
+        return;
+    }
+    unique_lock lock(mutex_);
+    WaitForWrite(lock);
+    CheckNewDocuments(documents);
+    vector<int> document_ids;
+    document_ids.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        document_ids.push_back(document.id);
+    }
+    LogAndApply(lock, move(document_ids), true,
+        [&documents](WriteAheadLog& log) { return log.AppendAdd(documents); },
+        [&]() { server_.AddDocuments(execution::par, documents); });
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    unique_lock lock(mutex_);
+    WaitForWrite(lock);
+    // удаление отсутствующего документа ничего не меняет, в журнал его не пишем
+    if (!HasDocument(document_id)) {
+        return;
+    }
+    LogAndApply(lock, { document_id }, false,
+        [document_id](WriteAheadLog& log) { return log.AppendRemove(WalRecordType::REMOVE_DOCUMENT, { document_id }); },
+        [&]() { server_.RemoveDocument(document_id); });
+}
+
+void DurableSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    unique_lock lock(mutex_);
+    WaitForWrite(lock);
+    if (none_of(document_ids.begin(), document_ids.end(), [this](int document_id) { return HasDocument(document_id); })) {
+        return;
+    }
+    LogAndApply(lock, document_ids, false,
+        [&document_ids](WriteAheadLog& log) { return log.AppendRemove(WalRecordType::REMOVE_DOCUMENTS, document_ids); },
+        [&]() { server_.RemoveDocuments(document_ids); });
+}
+
+template <typename Append>
+void DurableSearchServer::LogAndApply(unique_lock<mutex>& lock, vector<int> document_ids, bool present,
+    Append append, function<void()> apply) {
+    const uint64_t sequence = append(*log_);
+    const uint64_t change = next_change_++;
+    for (const int document_id : document_ids) {
+        pending_documents_[document_id] = { present, change };
+    }
+    pending_changes_.push_back({ change, sequence, move(document_ids), move(apply) });
+    const shared_ptr<WriteAheadLog> log = log_;
+    // пока запись сохраняется, другие потоки пишут свои, и у всех ожидающих общий fsync
+    lock.unlock();
+    try {
+        log->Commit(sequence);
+    } catch (const runtime_error&) {
+        lock.lock();
+        Fail();
+        throw;
+    }
+    lock.lock();
+    ApplyCommitted(sequence, change);
+    // изменение мог применить поток, раньше дождавшийся своей записи; до этого apply ссылается на аргументы вызова
+    applied_.wait(lock, [this, change]() { return failed_ || applied_changes_ > change; });
+    if (applied_changes_ <= change) {
+        throw runtime_error("Write-ahead log of "s + directory_ + " failed"s);
+    }
+}
+
+void DurableSearchServer::ApplyCommitted(uint64_t sequence, uint64_t own_change) {
+    // журнал сохраняет записи по порядку: раз сохранена запись sequence, сохранены и все до неё,
+    // поэтому первый проснувшийся поток группы применяет изменения всей группы
+    while (!failed_ && !pending_changes_.empty() && pending_changes_.front().sequence <= sequence) {
+        PendingChange& pending = pending_changes_.front();
+        try {
+            pending.apply();
+        } catch (const exception&) {
+            // запись уже в журнале, а индекс её не принял: дальше индекс и журнал разойдутся
+            Fail();
+            if (pending.change == own_change) {
+                throw;
+            }
+            break;
+        }
+        for (const int document_id : pending.document_ids) {
+            const auto it = pending_documents_.find(document_id);
+            if (it != pending_documents_.end() && it->second.second == pending.change) {
+                pending_documents_.erase(it);
+            }
+        }
+        pending_changes_.pop_front();
+        ++applied_changes_;
+    }
+    applied_.notify_all();
+}
+
+void DurableSearchServer::WaitForWrite(unique_lock<mutex>& lock) {
+    applied_.wait(lock, [this]() { return !checkpointing_; });
+    if (failed_) {
+        throw runtime_error("Write-ahead log of "s + directory_ + " failed"s);
+    }
+}
+
+void DurableSearchServer::Fail() {
+    failed_ = true;
+    applied_.notify_all();
+}
+
+bool DurableSearchServer::HasDocument(int document_id) const {
+    const auto it = pending_documents_.find(document_id);
+    if (it != pending_documents_.end()) {
+        return it->second.first;
+    }
+    return server_.document_to_ordinal_.count(document_id) > 0;
+}
+
+void DurableSearchServer::Sync() {
+    shared_ptr<WriteAheadLog> log;
+    {
+        lock_guard lock(mutex_);
+        log = log_;
+    }
+    log->Sync();
+}
+
+void DurableSearchServer::Checkpoint() {
+    unique_lock lock(mutex_);
+    WaitForWrite(lock);
+    // снимок должен содержать все записи журнала, который он заменяет
+    checkpointing_ = true;
+    applied_.wait(lock, [this]() { return failed_ || applied_changes_ == next_change_; });
+    checkpointing_ = false;
+    applied_.notify_all();
+    if (failed_) {
+        throw runtime_error("Write-ahead log of "s + directory_ + " failed"s);
+    }
+    log_->Sync();
+    const uint64_t generation = generation_ + 1;
+    // новый журнал создаётся раньше снимка: если сохранение прервётся, восстановление пройдёт по обоим журналам
+    auto log = make_shared<WriteAheadLog>(LogPath(generation), options_.sync_policy, options_.sync_interval);
+    SyncPath(directory_);
+    const string temporary_path = directory_ + "/snapshot.tmp"s;
+    server_.SaveSnapshot(temporary_path);
+    SyncPath(temporary_path);
+    // снимок появляется под своим именем только целиком
+    filesystem::rename(temporary_path, SnapshotPath(generation));
+    SyncPath(directory_);
+    log_ = move(log);
+    generation_ = generation;
+    RemoveFilesBefore(generation);
+}
+
+const SearchServer& DurableSearchServer::GetServer() const {
+    return server_;
+}
+
+string DurableSearchServer::SnapshotPath(uint64_t generation) const {
+    return directory_ + "/"s + SNAPSHOT_PREFIX + to_string(generation);
+}
+
+string DurableSearchServer::LogPath(uint64_t generation) const {
+    return directory_ + "/"s + LOG_PREFIX + to_string(generation);
+}
+
+void DurableSearchServer::Replay(const string& path, bool is_last) {
+    WalReader reader(path);
+    // подряд идущие добавления копятся и добавляются пакетом, тексты пакета живут в records
+    deque<WalRecord> records;
+    vector<NewDocument> documents;
+    auto add_documents = [&]() {
+        if (!documents.empty()) {
+            server_.AddDocuments(execution::par, documents);
+        }
+        documents.clear();
+        records.clear();
+    };
+    WalRecord record;
+    while (reader.Next(record)) {
+        if (record.type == WalRecordType::ADD_DOCUMENTS) {
+            records.push_back(move(record));
+            for (const WalDocument& document : records.back().documents) {
+                documents.push_back({ document.id, document.text, document.status, document.ratings });
+            }
+            if (documents.size() >= REPLAY_BATCH_SIZE) {
+                add_documents();
+            }
+        } else if (record.type == WalRecordType::REMOVE_DOCUMENT) {
+            add_documents();
+            server_.RemoveDocument(record.document_ids.front());
+        } else {
+            add_documents();
+            server_.RemoveDocuments(record.document_ids);
+        }
+    }
+    add_documents();
+    if (!is_last && reader.GetValidSize() != filesystem::file_size(path)) {
+        throw runtime_error("Write-ahead log "s + path + " is damaged"s);
+    }
+}
+
+void DurableSearchServer::CheckNewDocuments(const vector<NewDocument>& documents) const {
+    vector<int> document_ids;
+    document_ids.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        if ((document.id < 0) || HasDocument(document.id)) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        document_ids.push_back(document.id);
+    }
+    sort(document_ids.begin(), document_ids.end());
+    if (adjacent_find(document_ids.begin(), document_ids.end()) != document_ids.end()) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    for (const NewDocument& document : documents) {
+        for (const string_view word : SplitIntoWords(document.text)) {
+            if (!SearchServer::IsValidWord(word)) {
+                throw invalid_argument("Word "s + string(word) + " is invalid"s);
+            }
+        }
+    }
+}
+
+void DurableSearchServer::RemoveFilesBefore(uint64_t generation) const {
+    error_code error;
+    for (const uint64_t snapshot : FindGenerations(directory_, SNAPSHOT_PREFIX)) {
+        if (snapshot < generation) {
+            filesystem::remove(SnapshotPath(snapshot), error);
+        }
+    }
+    for (const uint64_t log : FindGenerations(directory_, LOG_PREFIX)) {
+        if (log < generation) {
+            filesystem::remove(LogPath(log), error);
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+struct DurabilityOptions {
+    WalSyncPolicy sync_policy = WalSyncPolicy::ALWAYS;
+    std::chrono::milliseconds sync_interval = WriteAheadLog::DEFAULT_SYNC_INTERVAL;
+    // формат и хранение текстов для пустого каталога; при восстановлении формат списков берётся из снимка
+    PostingLayout posting_layout = PostingLayout::PLAIN;
+    DocumentTextStorage text_storage = DocumentTextStorage::DISCARD;
+};
+
+// SearchServer, изменения которого переживают падение процесса. каждое добавление и удаление проверяется,
+// пишется в журнал, сохраняется по политике options.sync_policy и только потом применяется к индексу,
+// поэтому в индексе нет изменений, которых не будет после восстановления. в каталоге лежат снимок snapshot.N и журналы wal.N, wal.N+1, ...
+// с изменениями после него. Checkpoint сохраняет новый снимок, начинает новый журнал и удаляет старые файлы.
+// конструктор открывает последний снимок, повторяет журналы после него и отрезает недописанный хвост
+class DurableSearchServer {
+public:
+    // стоп-слова и options.posting_layout используются, пока в каталоге нет снимка, иначе они берутся из снимка
+    DurableSearchServer(std::string directory, std::string_view stop_words_text, DurabilityOptions options = {});
+    DurableSearchServer(const DurableSearchServer&) = delete;
+    DurableSearchServer& operator=(const DurableSearchServer&) = delete;
+
+    // проверки те же, что у SearchServer; документ, который сервер не примет, в журнал не попадает.
+    // изменения можно вызывать из разных потоков: fsync у одновременных вызовов общий, а применяются они
+    // в порядке записей журнала. если журнал не удалось записать, изменение не применяется, вызов бросает
+    // runtime_error, и дальше сервер изменений не принимает
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // пакет пишется в журнал одной записью и восстанавливается целиком или не восстанавливается совсем
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // сбрасывает журнал на диск при любой политике
+    void Sync();
+    // сохраняет снимок индекса, после чего журналы до него не нужны. на время сохранения изменения ждут
+    void Checkpoint();
+
+    // читать индекс можно, пока его никто не меняет
+    const SearchServer& GetServer() const;
+
+private:
+    std::string SnapshotPath(uint64_t generation) const;
+    std::string LogPath(uint64_t generation) const;
+    // повторяет записи журнала; испорченный хвост допустим только у последнего журнала
+    void Replay(const std::string& path, bool is_last);
+    // проверяет документы, не меняя индекс; бросает invalid_argument
+    void CheckNewDocuments(const std::vector<NewDocument>& documents) const;
+    // есть ли документ с учётом записанных в журнал, но ещё не применённых изменений
+    bool HasDocument(int document_id) const;
+    // ждёт очереди на изменение; бросает runtime_error, если журнал уже подвёл
+    void WaitForWrite(std::unique_lock<std::mutex>& lock);
+    // append пишет запись в журнал и возвращает её номер, apply меняет индекс. после append документы
+    // document_ids считаются присутствующими (present) для следующих проверок; lock отпускается, пока запись
+    // сохраняется. возвращается, когда изменение применено
+    template <typename Append>
+    void LogAndApply(std::unique_lock<std::mutex>& lock, std::vector<int> document_ids, bool present,
+        Append append, std::function<void()> apply);
+    // применяет по порядку ожидающие изменения с записями журнала не дальше sequence; исключение из apply
+    // изменения own_change пробрасывается
+    void ApplyCommitted(uint64_t sequence, uint64_t own_change);
+    void Fail();
+    // удаляет снимки и журналы старше generation
+    void RemoveFilesBefore(uint64_t generation) const;
+
+    const std::string directory_;
+    const DurabilityOptions options_;
+    // номер последнего снимка до восстановления, потом - номер журнала, в который идут записи
+    uint64_t generation_;
+    SearchServer server_;
+    std::mutex mutex_;
+    // журнал подменяется в Checkpoint, а потоки, ждущие Commit, держат свою копию указателя
+    std::shared_ptr<WriteAheadLog> log_;
+    // изменение, записанное в журнал, но ещё не применённое к индексу
+    struct PendingChange {
+        uint64_t change;
+        uint64_t sequence; // номер записи в журнале
+        std::vector<int> document_ids;
+        std::function<void()> apply;
+    };
+    // изменения получают номера в порядке записи в журнал и применяются по этим номерам
+    std::deque<PendingChange> pending_changes_;
+    std::condition_variable applied_;
+    uint64_t next_change_ = 0;
+    uint64_t applied_changes_ = 0;
+    // документы записанных, но не применённых изменений: есть ли документ после них и номер последнего из них
+    std::map<int, std::pair<bool, uint64_t>> pending_documents_;
+    // Checkpoint ждёт применения записанных изменений, новые изменения на это время ждут его
+    bool checkpointing_ = false;
+    // журнал не удалось записать или индекс не принял записанное изменение: изменения больше не принимаются
+    bool failed_ = false;
+};
@@ -0,0 +1,241 @@
+#include "external_index_builder.h"
+#include <algorithm>
+#include <filesystem>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+// меньше этого числа записей буфер чтения прогона не делаем, даже если прогонов очень много
+constexpr size_t MIN_MERGE_BUFFER_SIZE = 1024;
+
+bool OccurrenceLess(const IndexFileOccurrence& lhs, const IndexFileOccurrence& rhs) {
+    return tie(lhs.term_id, lhs.ordinal) < tie(rhs.term_id, rhs.ordinal);
+}
+
+// читает отсортированный прогон кусками по buffer_size записей
+class RunReader {
+public:
+    RunReader(const string& path, size_t buffer_size)
+        : in_(path, ios::binary)
+        , buffer_(buffer_size) {
+        if (!in_) {
+            throw runtime_error("Cannot open "s + path);
+        }
+        Fill();
+    }
+
+    bool AtEnd() const {
+        return position_ == size_;
+    }
+    const IndexFileOccurrence& Current() const {
+        return buffer_[position_];
+    }
+    void Next() {
+        if (++position_ == size_) {
+            Fill();
+        }
+    }
+
+private:
+    void Fill() {
+        in_.read(reinterpret_cast<char*>(buffer_.data()), buffer_.size() * sizeof(IndexFileOccurrence));
+        size_ = static_cast<size_t>(in_.gcount()) / sizeof(IndexFileOccurrence);
+        position_ = 0;
+    }
+
+    ifstream in_;
+    vector<IndexFileOccurrence> buffer_;
+    size_t position_ = 0;
+    size_t size_ = 0;
+};
+
+} // namespace
+
+ExternalIndexBuilder::ExternalIndexBuilder(const string& stop_words_text, string index_path, size_t memory_budget)
+    : ExternalIndexBuilder(move(index_path), memory_budget, MakeUniqueNonEmptyStrings(SplitIntoWords(stop_words_text))) {
+}
+
+ExternalIndexBuilder::ExternalIndexBuilder(string_view stop_words_text, string index_path, size_t memory_budget)
+    : ExternalIndexBuilder(move(index_path), memory_budget, MakeUniqueNonEmptyStrings(SplitIntoWords(stop_words_text))) {
+}
+
+ExternalIndexBuilder::ExternalIndexBuilder(string index_path, size_t memory_budget, set<string, less<>> stop_words)
+    : stop_words_(move(stop_words))
+    , index_path_(move(index_path))
+    , memory_budget_(memory_budget) {
+    if (!all_of(stop_words_.begin(), stop_words_.end(), SearchServer::IsValidWord)) {
+        throw invalid_argument("Some of stop words are invalid"s);
+    }
+    documents_.open(DocumentsPath(), ios::binary);
+    if (!documents_) {
+        throw runtime_error("Cannot create "s + DocumentsPath());
+    }
+}
+
+ExternalIndexBuilder::~ExternalIndexBuilder() {
+    documents_.close();
+    RemoveTemporaryFiles();
+}
+
+void ExternalIndexBuilder::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (finished_) {
+        throw logic_error("Index is already finished"s);
+    }
+    if ((document_id < 0) || (document_ids_.count(document_id) > 0)) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    const vector<string_view> words = SearchServer::SplitIntoWordsNoStop(document, stop_words_);
+    // слова получают номера в том же порядке, что и в SearchServer::AddDocument, поэтому загруженный индекс
+    // совпадает с построенным в памяти
+    vector<TermId> term_ids;
+    term_ids.reserve(words.size());
+    for (const string_view word : words) {
+        term_ids.push_back(terms_.Intern(word));
+    }
+    sort(term_ids.begin(), term_ids.end());
+
+    const uint32_t ordinal = static_cast<uint32_t>(document_ids_.size());
+    document_ids_.insert(document_id);
+    WriteValue(documents_, document_id);
+    WriteValue(documents_, static_cast<int32_t>(status));
+    WriteValue(documents_, static_cast<int32_t>(SearchServer::ComputeAverageRating(ratings)));
+    WriteValue(documents_, static_cast<uint64_t>(words.size()));
+    WriteString(documents_, document);
+    const size_t first_occurrence = occurrences_.size();
+    for (size_t i = 0; i < term_ids.size(); ++i) {
+        if (i == 0 || term_ids[i] != term_ids[i - 1]) {
+            occurrences_.push_back({ term_ids[i], ordinal, 0 });
+        }
+        ++occurrences_.back().count;
+    }
+    WriteValue(documents_, static_cast<uint64_t>(occurrences_.size() - first_occurrence));
+    for (size_t i = first_occurrence; i < occurrences_.size(); ++i) {
+        WriteValue(documents_, occurrences_[i].term_id);
+        WriteValue(documents_, occurrences_[i].count);
+    }
+    if (!documents_) {
+        throw runtime_error("Cannot write "s + DocumentsPath());
+    }
+    if (occurrences_.size() * sizeof(IndexFileOccurrence) >= memory_budget_) {
+        WriteRun();
+    }
+}
+
+void ExternalIndexBuilder::Finish() {
+    if (finished_) {
+        throw logic_error("Index is already finished"s);
+    }
+    if (!occurrences_.empty()) {
+        WriteRun();
+    }
+    vector<IndexFileOccurrence>().swap(occurrences_);
+    documents_.close();
+
+    ofstream out(index_path_, ios::binary);
+    WriteValue(out, INDEX_FILE_MAGIC);
+    WriteValue(out, INDEX_FILE_VERSION);
+    WriteValue(out, static_cast<uint64_t>(stop_words_.size()));
+    for (const string& stop_word : stop_words_) {
+        WriteString(out, stop_word);
+    }
+    WriteValue(out, static_cast<uint64_t>(terms_.size()));
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        WriteString(out, terms_.GetTerm(term_id));
+    }
+    WriteValue(out, static_cast<uint64_t>(document_ids_.size()));
+    if (!document_ids_.empty()) {
+        ifstream documents(DocumentsPath(), ios::binary);
+        out << documents.rdbuf();
+    }
+    WriteValue(out, occurrence_count_);
+    MergeRuns(out);
+    out.close();
+    if (!out) {
+        throw runtime_error("Cannot write "s + index_path_);
+    }
+    finished_ = true;
+    RemoveTemporaryFiles();
+}
+
+size_t ExternalIndexBuilder::GetDocumentCount() const {
+    return document_ids_.size();
+}
+
+size_t ExternalIndexBuilder::GetRunCount() const {
+    return run_count_;
+}
+
+string ExternalIndexBuilder::RunPath(size_t run) const {
+    return index_path_ + ".run"s + to_string(run) + ".tmp"s;
+}
+
+string ExternalIndexBuilder::DocumentsPath() const {
+    return index_path_ + ".documents.tmp"s;
+}
+
+void ExternalIndexBuilder::WriteRun() {
+    sort(occurrences_.begin(), occurrences_.end(), OccurrenceLess);
+    const string path = RunPath(run_count_);
+    ofstream out(path, ios::binary);
+    out.write(reinterpret_cast<const char*>(occurrences_.data()), occurrences_.size() * sizeof(IndexFileOccurrence));
+    out.close();
+    if (!out) {
+        throw runtime_error("Cannot write "s + path);
+    }
+    ++run_count_;
+    occurrence_count_ += occurrences_.size();
+    occurrences_.clear();
+}
+
+void ExternalIndexBuilder::MergeRuns(ostream& out) const {
+    // бюджет делится поровну между буферами прогонов и буфером записи
+    const size_t buffer_size = max(memory_budget_ / sizeof(IndexFileOccurrence) / (run_count_ + 1), MIN_MERGE_BUFFER_SIZE);
+    vector<RunReader> runs;
+    runs.reserve(run_count_);
+    for (size_t run = 0; run < run_count_; ++run) {
+        runs.emplace_back(RunPath(run), buffer_size);
+    }
+    // в куче номера прогонов, наверху прогон с наименьшей текущей записью
+    auto greater = [&runs](size_t lhs, size_t rhs) {
+        return OccurrenceLess(runs[rhs].Current(), runs[lhs].Current());
+    };
+    priority_queue<size_t, vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t run = 0; run < runs.size(); ++run) {
+        if (!runs[run].AtEnd()) {
+            heap.push(run);
+        }
+    }
+    vector<IndexFileOccurrence> merged;
+    merged.reserve(buffer_size);
+    auto flush = [&out, &merged]() {
+        out.write(reinterpret_cast<const char*>(merged.data()), merged.size() * sizeof(IndexFileOccurrence));
+        merged.clear();
+    };
+    while (!heap.empty()) {
+        const size_t run = heap.top();
+        heap.pop();
+        merged.push_back(runs[run].Current());
+        if (merged.size() == buffer_size) {
+            flush();
+        }
+        runs[run].Next();
+        if (!runs[run].AtEnd()) {
+            heap.push(run);
+        }
+    }
+    flush();
+}
+
+void ExternalIndexBuilder::RemoveTemporaryFiles() const {
+    error_code error;
+    filesystem::remove(DocumentsPath(), error);
+    for (size_t run = 0; run < run_count_; ++run) {
+        filesystem::remove(RunPath(run), error);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "document.h"
+#include "index_file.h"
+#include "string_processing.h"
+#include "term_dictionary.h"
+
+// строит файл индекса для SearchServer::LoadIndex, не держа списки вхождений в памяти.
+// документы сразу пишутся во временный файл, вхождения копятся в буфере размером memory_budget;
+// заполненный буфер сортируется по (слово, документ) и сбрасывается во временный файл прогона.
+// Finish сливает прогоны в файл индекса. в памяти остаются только словарь и id документов.
+// временные файлы лежат рядом с файлом индекса и удаляются в Finish или деструкторе
+class ExternalIndexBuilder {
+public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t{ 256 } << 20;
+
+    template <typename StringContainer>
+    ExternalIndexBuilder(const StringContainer& stop_words, std::string index_path, size_t memory_budget = DEFAULT_MEMORY_BUDGET);
+    ExternalIndexBuilder(const std::string& stop_words_text, std::string index_path, size_t memory_budget = DEFAULT_MEMORY_BUDGET);
+    ExternalIndexBuilder(std::string_view stop_words_text, std::string index_path, size_t memory_budget = DEFAULT_MEMORY_BUDGET);
+    ExternalIndexBuilder(const ExternalIndexBuilder&) = delete;
+    ExternalIndexBuilder& operator=(const ExternalIndexBuilder&) = delete;
+    ~ExternalIndexBuilder();
+
+    // проверки те же, что у SearchServer::AddDocument
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // сливает прогоны в файл индекса; после этого документы добавлять нельзя
+    void Finish();
+
+    size_t GetDocumentCount() const;
+    // число прогонов, сброшенных на диск
+    size_t GetRunCount() const;
+
+private:
+    ExternalIndexBuilder(std::string index_path, size_t memory_budget, std::set<std::string, std::less<>> stop_words);
+
+    std::string RunPath(size_t run) const;
+    std::string DocumentsPath() const;
+    // сортирует буфер вхождений и пишет его в новый прогон
+    void WriteRun();
+    // сливает прогоны в out, на буферы чтения прогонов уходит memory_budget_
+    void MergeRuns(std::ostream& out) const;
+    void RemoveTemporaryFiles() const;
+
+    const std::set<std::string, std::less<>> stop_words_;
+    const std::string index_path_;
+    const size_t memory_budget_;
+    TermDictionary terms_;
+    std::set<int> document_ids_;
+    std::ofstream documents_;
+    std::vector<IndexFileOccurrence> occurrences_;
+    size_t run_count_ = 0;
+    uint64_t occurrence_count_ = 0;
+    bool finished_ = false;
+};
+
+template <typename StringContainer>
+ExternalIndexBuilder::ExternalIndexBuilder(const StringContainer& stop_words, std::string index_path, size_t memory_budget)
+    : ExternalIndexBuilder(std::move(index_path), memory_budget, MakeUniqueNonEmptyStrings(stop_words)) {
+}
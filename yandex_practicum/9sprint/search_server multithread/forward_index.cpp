@@ -0,0 +1,75 @@
+#include "forward_index.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+ForwardIndex::ForwardIndex() {
+    offsets_.Mutable().push_back(0);
+}
+
+void ForwardIndex::Add(std::vector<TermId> term_ids, double word_weight) {
+    std::vector<TermId>& document_term_ids = term_ids_.Mutable();
+    std::vector<double>& term_freqs = term_freqs_.Mutable();
+    std::sort(term_ids.begin(), term_ids.end());
+    for (size_t i = 0; i < term_ids.size(); ++i) {
+        // частота набирается сложением по вхождениям, как в списках вхождений, чтобы значения совпадали до бита
+        if (i == 0 || term_ids[i] != term_ids[i - 1]) {
+            document_term_ids.push_back(term_ids[i]);
+            term_freqs.push_back(0.0);
+        }
+        term_freqs.back() += word_weight;
+    }
+    offsets_.Mutable().push_back(document_term_ids.size());
+}
+
+void ForwardIndex::Compact(const std::vector<int>& new_ordinals) {
+    std::vector<TermId>& term_ids = term_ids_.Mutable();
+    std::vector<double>& term_freqs = term_freqs_.Mutable();
+    std::vector<size_t>& offsets = offsets_.Mutable();
+    // запись всегда идёт не дальше чтения, поэтому массивы сдвигаются на месте
+    size_t kept = 0;
+    size_t document_count = 0;
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] < 0) {
+            continue;
+        }
+        const size_t first = offsets[ordinal];
+        const size_t last = offsets[ordinal + 1];
+        std::copy(term_ids.begin() + first, term_ids.begin() + last, term_ids.begin() + kept);
+        std::copy(term_freqs.begin() + first, term_freqs.begin() + last, term_freqs.begin() + kept);
+        kept += last - first;
+        offsets[++document_count] = kept;
+    }
+    term_ids.resize(kept);
+    term_freqs.resize(kept);
+    offsets.resize(document_count + 1);
+    term_ids.shrink_to_fit();
+    term_freqs.shrink_to_fit();
+    offsets.shrink_to_fit();
+}
+
+ForwardIndex::SnapshotEntry ForwardIndex::Save(SnapshotWriter& writer) const {
+    return { writer.Write(term_ids_), writer.Write(term_freqs_), writer.Write(offsets_) };
+}
+
+void ForwardIndex::Load(const SnapshotReader& reader, const SnapshotEntry& entry, size_t document_count, size_t term_count) {
+    term_ids_ = reader.Array<TermId>(entry.term_ids);
+    term_freqs_ = reader.Array<double>(entry.term_freqs);
+    offsets_ = reader.Array<size_t>(entry.offsets);
+    if (offsets_.size() != document_count + 1 || offsets_[0] != 0 || offsets_.back() != term_ids_.size()
+        || term_freqs_.size() != term_ids_.size()) {
+        throw std::runtime_error("Snapshot file is damaged");
+    }
+    // по номерам слов прямого индекса удаление документа правит списки вхождений, поэтому они проверяются все
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        if (offsets_[ordinal + 1] < offsets_[ordinal] || offsets_[ordinal + 1] > term_ids_.size()) {
+            throw std::runtime_error("Snapshot file is damaged");
+        }
+        for (size_t i = offsets_[ordinal]; i < offsets_[ordinal + 1]; ++i) {
+            if (term_ids_[i] >= term_count || (i > offsets_[ordinal] && term_ids_[i] <= term_ids_[i - 1])
+                || !(term_freqs_[i] > 0.0 && term_freqs_[i] <= std::numeric_limits<double>::max())) {
+                throw std::runtime_error("Snapshot file is damaged");
+            }
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "mapped_array.h"
+#include "snapshot_file.h"
+#include "term_dictionary.h"
+
+// прямой индекс: слова каждого документа с их частотами, упорядоченные по номеру слова.
+// пары всех документов лежат подряд в двух общих массивах, документ адресуется порядковым номером
+class ForwardIndex {
+public:
+    // слова документа и их частоты, term_ids отсортированы
+    struct DocumentTerms {
+        const TermId* term_ids;
+        const double* term_freqs;
+        size_t size;
+    };
+
+    // описание прямого индекса в снимке
+    struct SnapshotEntry {
+        SnapshotArray term_ids;
+        SnapshotArray term_freqs;
+        SnapshotArray offsets;
+    };
+
+    ForwardIndex();
+
+    // добавляет документ со следующим порядковым номером; term_ids - слова документа с повторами,
+    // каждое вхождение слова добавляет к его частоте word_weight
+    void Add(std::vector<TermId> term_ids, double word_weight);
+    DocumentTerms Get(int ordinal) const {
+        const size_t first = offsets_[ordinal];
+        return { term_ids_.data() + first, term_freqs_.data() + first, offsets_[ordinal + 1] - first };
+    }
+    // оставляет документы с new_ordinals[номер] >= 0 под новыми номерами, порядок документов сохраняется
+    void Compact(const std::vector<int>& new_ordinals);
+
+    SnapshotEntry Save(SnapshotWriter& writer) const;
+    // заменяет индекс сохранённым в снимке, массивы смотрят в страницы снимка. в индексе должно быть
+    // document_count документов, а номера слов - расти внутри документа и быть меньше term_count
+    void Load(const SnapshotReader& reader, const SnapshotEntry& entry, size_t document_count, size_t term_count);
+
+private:
+    MappedArray<TermId> term_ids_;
+    MappedArray<double> term_freqs_;
+    MappedArray<size_t> offsets_; // пары документа - [offsets_[номер], offsets_[номер + 1])
+};
@@ -0,0 +1,39 @@
+#include "impact_index.h"
+#include <cmath>
+
+void ImpactPostingList::Reserve(size_t size) {
+    ordinals_.reserve(size);
+    impacts_.reserve(size);
+}
+
+void ImpactPostingList::Add(int ordinal, uint16_t impact) {
+    ordinals_.push_back(ordinal);
+    impacts_.push_back(impact);
+}
+
+size_t ImpactPostingList::size() const {
+    return ordinals_.size();
+}
+
+ImpactPostingList::Cursor::Cursor(const ImpactPostingList& postings, int first_ordinal, int last_ordinal)
+    : ordinals_(postings.ordinals_.data())
+    , impacts_(postings.impacts_.data()) {
+    const int* end = ordinals_ + postings.ordinals_.size();
+    position_ = std::lower_bound(ordinals_, end, first_ordinal);
+    last_ = std::lower_bound(position_, end, last_ordinal);
+}
+
+void ImpactIndex::Reset(size_t term_count, double max_impact, uint64_t version) {
+    postings_.assign(term_count, ImpactPostingList());
+    step_ = max_impact > 0.0 ? max_impact / MAX_IMPACT : 1.0;
+    version_ = version;
+}
+
+void ImpactIndex::Reserve(TermId term_id, size_t size) {
+    postings_[term_id].Reserve(size);
+}
+
+void ImpactIndex::Add(TermId term_id, int ordinal, double impact) {
+    const double steps = std::round(impact / step_);
+    postings_[term_id].Add(ordinal, static_cast<uint16_t>(std::clamp(steps, 0.0, static_cast<double>(MAX_IMPACT))));
+}
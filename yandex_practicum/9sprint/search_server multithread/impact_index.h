@@ -0,0 +1,90 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "term_dictionary.h"
+
+// список вхождений слова с квантованными вкладами: вместо частоты у документа хранится
+// его tf-idf по этому слову, округлённое до целого числа шагов индекса (6 байт на вхождение вместо 12)
+class ImpactPostingList {
+public:
+    void Reserve(size_t size);
+    // документы добавляются по возрастанию номера
+    void Add(int ordinal, uint16_t impact);
+
+    size_t size() const;
+
+    // курсор по вхождениям с номерами из [first_ordinal, last_ordinal), весь диапазон - один кусок
+    class Cursor {
+    public:
+        Cursor(const ImpactPostingList& postings, int first_ordinal, int last_ordinal);
+
+        bool AtEnd() const {
+            return position_ == last_;
+        }
+        const int* ChunkOrdinals() const {
+            return position_;
+        }
+        size_t ChunkSize() const {
+            return last_ - position_;
+        }
+        uint16_t ChunkImpact(size_t i) const {
+            return impacts_[position_ - ordinals_ + i];
+        }
+        void NextChunk() {
+            position_ = last_;
+        }
+
+    private:
+        const int* ordinals_;
+        const uint16_t* impacts_;
+        const int* position_;
+        const int* last_;
+    };
+
+private:
+    std::vector<int> ordinals_;
+    std::vector<uint16_t> impacts_;
+};
+
+// снимок индекса с квантованными вкладами слов, по нему релевантность набирается сложением целых.
+// шаг общий для всех слов, поэтому суммы вкладов разных слов сравнимы. снимок строится по текущему
+// индексу и устаревает при любом его изменении, версия индекса запоминается при построении
+class ImpactIndex {
+public:
+    static constexpr uint32_t MAX_IMPACT = std::numeric_limits<uint16_t>::max();
+
+    // начинает новый снимок на term_count слов, шаг подбирается так, чтобы max_impact стал MAX_IMPACT
+    void Reset(size_t term_count, double max_impact, uint64_t version);
+    void Reserve(TermId term_id, size_t size);
+    // вхождения каждого слова добавляются по возрастанию номера
+    void Add(TermId term_id, int ordinal, double impact);
+
+    bool IsCurrent(uint64_t version) const {
+        return version_ == version;
+    }
+    // цена единицы вклада; округлённый вклад отличается от точного не больше чем на половину шага
+    double Step() const {
+        return step_;
+    }
+    const std::vector<ImpactPostingList>& Postings() const {
+        return postings_;
+    }
+
+private:
+    static constexpr uint64_t NO_VERSION = std::numeric_limits<uint64_t>::max();
+
+    std::vector<ImpactPostingList> postings_;
+    double step_ = 1.0;
+    uint64_t version_ = NO_VERSION;
+};
+
+// расхождение выдачи по квантованным вкладам с точной выдачей
+struct ImpactDeviation {
+    size_t candidate_count = 0;       // документов, релевантность которых пересчитана точно
+    size_t top_count = 0;             // документов в точной выдаче
+    size_t top_overlap = 0;           // сколько из них попало бы в выдачу и без точного пересчёта
+    double max_relevance_error = 0.0; // наибольшая разница квантованной и точной релевантности у кандидатов
+};
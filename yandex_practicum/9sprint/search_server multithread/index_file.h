@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// файл индекса, собранного ExternalIndexBuilder, по порядку:
+//   заголовок: INDEX_FILE_MAGIC, INDEX_FILE_VERSION
+//   стоп-слова: число, строки
+//   словарь: число слов, строки в порядке номеров
+//   документы в порядке номеров: id, статус, рейтинг, число слов, текст,
+//     число разных слов и пары (номер слова, число вхождений) по возрастанию номера слова
+//   вхождения: число записей и записи IndexFileOccurrence по возрастанию (номер слова, номер документа)
+// строка пишется длиной и байтами, числа - в порядке байт машины
+constexpr uint32_t INDEX_FILE_MAGIC = 0x58444953; // "SIDX"
+constexpr uint32_t INDEX_FILE_VERSION = 1;
+
+struct IndexFileOccurrence {
+    uint32_t term_id;
+    uint32_t ordinal;
+    uint32_t count;
+};
+
+template <typename T>
+void WriteValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T ReadValue(std::istream& in) {
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+        throw std::runtime_error("Unexpected end of index file");
+    }
+    return value;
+}
+
+inline void WriteString(std::ostream& out, std::string_view text) {
+    WriteValue(out, static_cast<uint64_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+// длина больше max_size - признак испорченного файла, а не повод выделять память
+inline std::string ReadString(std::istream& in, uint64_t max_size = UINT64_MAX) {
+    const uint64_t size = ReadValue<uint64_t>(in);
+    if (size > max_size) {
+        throw std::runtime_error("Index file is damaged");
+    }
+    std::string text(size, '\0');
+    if (!in.read(text.data(), text.size())) {
+        throw std::runtime_error("Unexpected end of index file");
+    }
+    return text;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "string_processing.h"
+
+// общие части серверов, которые подменяют опубликованный индекс, не дожидаясь читателей:
+// SwappableSearchServer и SegmentedSearchServer
+
+struct NoRetiredTag {
+};
+
+// объекты, выпавшие из опубликованного индекса, с меткой Tag. читатели, взявшие индекс до подмены,
+// ещё могут на них ссылаться, поэтому объект можно освободить, когда последняя ссылка на него - в списке
+template <typename Tag = NoRetiredTag>
+class RetiredList {
+public:
+    struct Entry {
+        std::shared_ptr<const void> object;
+        Tag tag;
+    };
+
+    void Add(std::shared_ptr<const void> object, Tag tag = {}) {
+        entries_.push_back({ std::move(object), std::move(tag) });
+    }
+
+    bool empty() const {
+        return entries_.empty();
+    }
+
+    // извлекает объекты, которые больше никто не держит. деструктор большого индекса долгий,
+    // поэтому вызывающий освобождает их, отпустив свою блокировку
+    std::vector<Entry> ExtractUnused() {
+        const auto unused_begin = std::partition(entries_.begin(), entries_.end(), [](const Entry& entry) {
+            return entry.object.use_count() > 1;
+            });
+        std::vector<Entry> unused(std::make_move_iterator(unused_begin), std::make_move_iterator(entries_.end()));
+        entries_.erase(unused_begin, entries_.end());
+        return unused;
+    }
+
+private:
+    std::vector<Entry> entries_;
+};
+
+// найденные MatchDocument слова ссылаются на словарь индекса, который могут освободить после подмены;
+// заменяет их такими же словами из raw_query
+inline void RebindToQuery(std::string_view raw_query, std::vector<std::string_view>& matched_words) {
+    std::vector<std::string_view> query_words = SplitIntoWords(raw_query);
+    std::sort(query_words.begin(), query_words.end());
+    for (std::string_view& word : matched_words) {
+        word = *std::lower_bound(query_words.begin(), query_words.end(), word);
+    }
+}
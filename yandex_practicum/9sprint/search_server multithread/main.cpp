@@ -1 +1,13 @@
+#include <string>
+#include "benchmark_functions.h"
+#include "test_examp_functions.h"
 
+using namespace std;
+
+// без аргументов запускает тесты; "bench [layouts|modes|kernels|churn|wal|mixed]" - ещё и бенчмарки
+int main(int argc, char* argv[]) {
+    TestSearchServer();
+    if (argc > 1 && argv[1] == "bench"s) {
+        RunBenchmarks(argc > 2 ? argv[2] : "all");
+    }
+}
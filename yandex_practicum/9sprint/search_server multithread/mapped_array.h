@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// массив, который либо владеет своими данными, либо смотрит на чужую память - страницы открытого снимка.
+// читается одинаково в обоих случаях, а перед первым изменением данные снимка копируются в собственный вектор
+template <typename T>
+class MappedArray {
+public:
+    MappedArray() = default;
+
+    // массив смотрит на size элементов по адресу data; память должна жить дольше массива
+    static MappedArray View(const T* data, size_t size) {
+        MappedArray array;
+        if (size > 0) {
+            array.view_ = data;
+            array.view_size_ = size;
+        }
+        return array;
+    }
+
+    const T* data() const {
+        return view_ != nullptr ? view_ : owned_.data();
+    }
+    size_t size() const {
+        return view_ != nullptr ? view_size_ : owned_.size();
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+    const T& back() const {
+        return data()[size() - 1];
+    }
+    const T* begin() const {
+        return data();
+    }
+    const T* end() const {
+        return data() + size();
+    }
+
+    // вектор для изменения массива; данные снимка копируются в него при первом вызове
+    std::vector<T>& Mutable() {
+        if (view_ != nullptr) {
+            owned_.assign(view_, view_ + view_size_);
+            view_ = nullptr;
+            view_size_ = 0;
+        }
+        return owned_;
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+};
@@ -0,0 +1,209 @@
+#include "memtable.h"
+#include <cstdint>
+#include "search_server.h"
+#include "string_processing.h"
+
+using namespace std;
+
+MemTable::Term::Term(string_view text)
+    : text_(text) {
+}
+
+pair<const MemTable::Posting*, const MemTable::Posting*> MemTable::Term::GetPostings(size_t ordinal_count) const {
+    const size_t size = size_.load(memory_order_acquire);
+    const Posting* postings = postings_.load(memory_order_acquire);
+    // вхождения документов, которых читатель ещё не видит, лежат в конце
+    const Posting* last = partition_point(postings, postings + size, [ordinal_count](const Posting& posting) {
+        return static_cast<size_t>(posting.ordinal) < ordinal_count;
+        });
+    return { postings, last };
+}
+
+void MemTable::Term::Append(Posting posting) {
+    const size_t size = size_.load(memory_order_relaxed);
+    if (size == capacity_) {
+        capacity_ = max<size_t>(2, 2 * capacity_);
+        auto block = make_unique<Posting[]>(capacity_);
+        if (size > 0) {
+            copy(blocks_.back().get(), blocks_.back().get() + size, block.get());
+        }
+        postings_.store(block.get(), memory_order_release);
+        blocks_.push_back(move(block));
+    }
+    blocks_.back()[size] = posting;
+    size_.store(size + 1, memory_order_release);
+}
+
+MemTable::TermTable::TermTable(size_t slot_count)
+    : slots(make_unique<atomic<Term*>[]>(slot_count))
+    , mask(slot_count - 1) {
+}
+
+MemTable::Term* MemTable::TermTable::Find(string_view text) const {
+    for (size_t slot = hash<string_view>{}(text) & mask;; slot = (slot + 1) & mask) {
+        Term* term = slots[slot].load(memory_order_acquire);
+        if (term == nullptr || term->GetText() == text) {
+            return term;
+        }
+    }
+}
+
+void MemTable::TermTable::Insert(Term* term) {
+    size_t slot = hash<string_view>{}(term->GetText()) & mask;
+    while (slots[slot].load(memory_order_relaxed) != nullptr) {
+        slot = (slot + 1) & mask;
+    }
+    slots[slot].store(term, memory_order_release);
+}
+
+MemTable::MemTable(shared_ptr<const set<string, less<>>> stop_words, size_t capacity, bool keep_text)
+    : stop_words_(move(stop_words))
+    , keep_text_(keep_text)
+    , documents_(capacity) {
+    size_t id_slot_count = 2;
+    id_shift_ = 63;
+    while (id_slot_count < 2 * capacity) {
+        id_slot_count *= 2;
+        --id_shift_;
+    }
+    id_slots_ = make_unique<atomic<int>[]>(id_slot_count);
+    id_mask_ = id_slot_count - 1;
+    term_tables_.push_back(make_unique<TermTable>(64));
+    term_table_.store(term_tables_.back().get(), memory_order_release);
+}
+
+void MemTable::Add(int document_id, string_view text, const vector<string_view>& words, DocumentStatus status, int rating) {
+    const int ordinal = static_cast<int>(size_);
+    DocumentEntry& document = documents_[ordinal];
+    document.id = document_id;
+    document.rating = rating;
+    document.status = status;
+    document.word_weight = 1.0 / words.size();
+    if (keep_text_) {
+        document.text = string(text);
+    }
+    // по алфавиту повторы слова оказываются рядом
+    vector<string_view> sorted_words(words);
+    sort(sorted_words.begin(), sorted_words.end());
+    for (auto word_it = sorted_words.begin(); word_it != sorted_words.end();) {
+        const auto next_it = find_if(word_it, sorted_words.end(), [word = *word_it](string_view other) {
+            return other != word;
+            });
+        const int occurrences = static_cast<int>(next_it - word_it);
+        // частота складывается по вхождениям, как в PostingList::Add, поэтому совпадает до бита
+        double term_freq = 0.0;
+        for (int i = 0; i < occurrences; ++i) {
+            term_freq += document.word_weight;
+        }
+        Term* term = InternTerm(*word_it);
+        term->Append({ ordinal, term_freq });
+        document.terms.push_back({ term, occurrences });
+        word_it = next_it;
+    }
+    size_t slot = GetIdSlot(document_id);
+    while (id_slots_[slot].load(memory_order_relaxed) != 0) {
+        slot = (slot + 1) & id_mask_;
+    }
+    id_slots_[slot].store(ordinal + 1, memory_order_release);
+    ++size_;
+}
+
+int MemTable::FindOrdinal(int document_id, size_t ordinal_count, const Bitmap* removed) const {
+    // id удалённого документа мог быть добавлен заново, поэтому просматриваются все ячейки с этим id
+    for (size_t slot = GetIdSlot(document_id);; slot = (slot + 1) & id_mask_) {
+        const int stored = id_slots_[slot].load(memory_order_acquire);
+        if (stored == 0) {
+            return -1;
+        }
+        const int ordinal = stored - 1;
+        if (static_cast<size_t>(ordinal) < ordinal_count && documents_[ordinal].id == document_id
+            && (removed == nullptr || !removed->Test(ordinal))) {
+            return ordinal;
+        }
+    }
+}
+
+const MemTable::Term* MemTable::FindTerm(string_view text) const {
+    return term_table_.load(memory_order_acquire)->Find(text);
+}
+
+size_t MemTable::GetDocumentFreq(const Term& term, size_t ordinal_count, const Bitmap* removed) const {
+    const auto [first, last] = term.GetPostings(ordinal_count);
+    if (removed == nullptr) {
+        return static_cast<size_t>(last - first);
+    }
+    return static_cast<size_t>(count_if(first, last, [removed](const Posting& posting) {
+        return !removed->Test(posting.ordinal);
+        }));
+}
+
+MemTable::Query MemTable::ParseQuery(string_view text) const {
+    Query query;
+    for (const string_view word : SplitIntoWords(text)) {
+        const auto query_word = SearchServer::ParseQueryWord(word, *stop_words_);
+        if (query_word.is_stop) {
+            continue;
+        }
+        // слова, которых нет в сегменте, не могут ничего найти или исключить
+        const Term* term = FindTerm(query_word.data);
+        if (term == nullptr) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            query.minus_terms.push_back(term);
+        }
+        else {
+            query.plus_terms.push_back(term);
+        }
+    }
+    sort(query.plus_terms.begin(), query.plus_terms.end(), [](const Term* lhs, const Term* rhs) {
+        return lhs->GetText() < rhs->GetText();
+        });
+    query.plus_terms.erase(unique(query.plus_terms.begin(), query.plus_terms.end()), query.plus_terms.end());
+    return query;
+}
+
+tuple<vector<string_view>, DocumentStatus> MemTable::MatchDocument(string_view raw_query, int ordinal) const {
+    const Query query = ParseQuery(raw_query);
+    const DocumentEntry& document = documents_[ordinal];
+    const auto contains_term = [&document](const Term* term) {
+        return any_of(document.terms.begin(), document.terms.end(), [term](const pair<const Term*, int>& document_term) {
+            return document_term.first == term;
+            });
+    };
+    if (any_of(query.minus_terms.begin(), query.minus_terms.end(), contains_term)) {
+        return { vector<string_view>{}, document.status };
+    }
+    // плюс-слова запроса уже по алфавиту
+    vector<string_view> matched_words;
+    for (const Term* term : query.plus_terms) {
+        if (contains_term(term)) {
+            matched_words.push_back(term->GetText());
+        }
+    }
+    return { matched_words, document.status };
+}
+
+MemTable::Term* MemTable::InternTerm(string_view text) {
+    TermTable* table = term_tables_.back().get();
+    if (Term* term = table->Find(text)) {
+        return term;
+    }
+    if (2 * (terms_.size() + 1) > table->mask + 1) {
+        auto grown = make_unique<TermTable>(2 * (table->mask + 1));
+        for (const auto& term : terms_) {
+            grown->Insert(term.get());
+        }
+        table = grown.get();
+        term_tables_.push_back(move(grown));
+        term_table_.store(table, memory_order_release);
+    }
+    terms_.push_back(make_unique<Term>(text));
+    table->Insert(terms_.back().get());
+    return terms_.back().get();
+}
+
+size_t MemTable::GetIdSlot(int document_id) const {
+    // умножение перемешивает id, иначе id с общим шагом, кратным степени двойки, легли бы в одни ячейки
+    return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(document_id)) * 0x9E3779B97F4A7C15ull) >> id_shift_);
+}
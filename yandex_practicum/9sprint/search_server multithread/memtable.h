@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "bitmap.h"
+#include "document.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+
+// изменяемый сегмент SegmentedSearchServer. документы только дописываются в конец, а записанное не двигается
+// в памяти: массив, которому не хватило места, копируется в новый, старый живёт до конца сегмента.
+// поэтому читатель, взявший из опубликованной версии число документов ordinal_count, без блокировок
+// видит первые ordinal_count документов, пока писатель дописывает следующие. писатель должен быть один.
+// удаления сегмент не хранит: карту удалённых номеров держит версия индекса
+class MemTable {
+public:
+    struct Posting {
+        int ordinal;
+        double term_freq;
+    };
+
+    // слово сегмента и его вхождения по возрастанию номера документа
+    class Term {
+    public:
+        explicit Term(std::string_view text);
+
+        std::string_view GetText() const {
+            return text_;
+        }
+        // вхождения документов с номерами меньше ordinal_count
+        std::pair<const Posting*, const Posting*> GetPostings(size_t ordinal_count) const;
+        // дописывает вхождение документа с номером больше прежних
+        void Append(Posting posting);
+
+    private:
+        std::string text_;
+        // писатель сначала публикует новый массив, затем размер, поэтому по прочитанному размеру массив уже есть
+        std::atomic<const Posting*> postings_{ nullptr };
+        std::atomic<size_t> size_{ 0 };
+        // текущий и заменённые массивы, их видит только писатель
+        std::vector<std::unique_ptr<Posting[]>> blocks_;
+        size_t capacity_ = 0;
+    };
+
+    struct DocumentEntry {
+        int id = 0;
+        int rating = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        double word_weight = 0.0;
+        // слова документа по алфавиту и число их вхождений
+        std::vector<std::pair<const Term*, int>> terms;
+        // пусто, если сегмент не хранит тексты
+        std::string text;
+    };
+
+    // слова запроса, которые есть в сегменте; плюс-слова по алфавиту, без повторов
+    struct Query {
+        std::vector<const Term*> plus_terms;
+        std::vector<const Term*> minus_terms;
+        // IDF плюс-слов в том же порядке, их подставляет SegmentedSearchServer по всему индексу
+        std::vector<double> inverse_document_freqs;
+    };
+
+    // capacity - сколько документов поместится в сегмент
+    MemTable(std::shared_ptr<const std::set<std::string, std::less<>>> stop_words, size_t capacity, bool keep_text);
+    MemTable(const MemTable&) = delete;
+    MemTable& operator=(const MemTable&) = delete;
+
+    // дописывает документ со следующим номером. words - слова текста без стоп-слов, id не проверяется
+    void Add(int document_id, std::string_view text, const std::vector<std::string_view>& words, DocumentStatus status, int rating);
+    // число дописанных документов, его знает только писатель; читатель берёт своё число из версии
+    size_t size() const {
+        return size_;
+    }
+    size_t capacity() const {
+        return documents_.size();
+    }
+
+    // номер документа document_id среди первых ordinal_count, не отмеченного в removed, или -1
+    int FindOrdinal(int document_id, size_t ordinal_count, const Bitmap* removed) const;
+    const DocumentEntry& GetDocument(int ordinal) const {
+        return documents_[ordinal];
+    }
+    // слово сегмента или nullptr
+    const Term* FindTerm(std::string_view text) const;
+    // число документов со словом среди первых ordinal_count, кроме отмеченных в removed
+    size_t GetDocumentFreq(const Term& term, size_t ordinal_count, const Bitmap* removed) const;
+
+    // бросает invalid_argument на том же запросе, что и SearchServer
+    Query ParseQuery(std::string_view text) const;
+    // полный перебор вхождений: изменяемый сегмент мал, блочных оценок у него нет
+    template <typename OrdinalFilter>
+    TopDocuments FindAllDocuments(const Query& query, OrdinalFilter ordinal_filter, size_t ordinal_count, size_t top_count) const;
+    // найденные слова ссылаются на строки сегмента
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int ordinal) const;
+
+    // фильтры по номеру документа с теми же именами, что у SearchServer
+    template <typename DocumentPredicate>
+    auto MakeOrdinalFilter(DocumentPredicate document_predicate) const;
+    auto MakeStatusFilter(DocumentStatus status) const;
+
+private:
+    // хеш-таблица слов с открытой адресацией. заполненная наполовину таблица заменяется вдвое большей,
+    // старая остаётся читателям, которые успели её взять
+    struct TermTable {
+        explicit TermTable(size_t slot_count);
+
+        Term* Find(std::string_view text) const;
+        void Insert(Term* term);
+
+        std::unique_ptr<std::atomic<Term*>[]> slots;
+        size_t mask;
+    };
+
+    Term* InternTerm(std::string_view text);
+    // первая ячейка, с которой ищется id
+    size_t GetIdSlot(int document_id) const;
+
+    const std::shared_ptr<const std::set<std::string, std::less<>>> stop_words_;
+    const bool keep_text_;
+    // документы по номеру; место под все capacity документов выделено сразу, поэтому вектор не перемещается
+    std::vector<DocumentEntry> documents_;
+    size_t size_ = 0;
+    // номер документа + 1 по id, 0 - пустая ячейка; ячеек вдвое больше, чем документов
+    std::unique_ptr<std::atomic<int>[]> id_slots_;
+    size_t id_mask_ = 0;
+    int id_shift_ = 0;
+    std::atomic<const TermTable*> term_table_{ nullptr };
+    // всё, что видит только писатель: слова и все таблицы слов, включая заменённые
+    std::vector<std::unique_ptr<Term>> terms_;
+    std::vector<std::unique_ptr<TermTable>> term_tables_;
+};
+
+template <typename OrdinalFilter>
+TopDocuments MemTable::FindAllDocuments(const Query& query, OrdinalFilter ordinal_filter, size_t ordinal_count, size_t top_count) const {
+    using namespace std;
+    // у каждого потока свой накопитель, он переиспользуется между запросами
+    static thread_local ScoreAccumulator<double> accumulator;
+    static thread_local vector<int> excluded;
+    accumulator.Reset(ordinal_count);
+    excluded.clear();
+    for (const Term* term : query.minus_terms) {
+        const auto [first, last] = term->GetPostings(ordinal_count);
+        for (const Posting* posting = first; posting != last; ++posting) {
+            excluded.push_back(posting->ordinal);
+        }
+    }
+    sort(excluded.begin(), excluded.end());
+
+    for (size_t word = 0; word < query.plus_terms.size(); ++word) {
+        const double inverse_document_freq = query.inverse_document_freqs[word];
+        const auto [first, last] = query.plus_terms[word]->GetPostings(ordinal_count);
+        for (const Posting* posting = first; posting != last; ++posting) {
+            if (ordinal_filter(posting->ordinal)) {
+                accumulator.Add(posting->ordinal, posting->term_freq * inverse_document_freq);
+            }
+        }
+    }
+    TopDocuments top_documents(top_count);
+    for (const int ordinal : accumulator.Touched()) {
+        if (!binary_search(excluded.begin(), excluded.end(), ordinal)) {
+            top_documents.Push({ documents_[ordinal].id, accumulator.GetScore(ordinal), documents_[ordinal].rating });
+        }
+    }
+    return top_documents;
+}
+
+template <typename DocumentPredicate>
+auto MemTable::MakeOrdinalFilter(DocumentPredicate document_predicate) const {
+    return [this, document_predicate](int ordinal) {
+        const DocumentEntry& document = documents_[ordinal];
+        return document_predicate(document.id, document.status, document.rating);
+    };
+}
+
+inline auto MemTable::MakeStatusFilter(DocumentStatus status) const {
+    return [this, status](int ordinal) {
+        return documents_[ordinal].status == status;
+    };
+}
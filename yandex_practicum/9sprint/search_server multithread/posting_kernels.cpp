@@ -0,0 +1,329 @@
+#include "posting_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POSTING_KERNELS_X86
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define POSTING_KERNELS_X86
+#define TARGET_SSE4
+#define TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+size_t CountLessScalar(const int* values, size_t count, int value) {
+    return lower_bound(values, values + count, value) - values;
+}
+
+void PrefixSumGapsScalar(int first, const uint32_t* gaps, size_t gap_count, int* ids) {
+    ids[0] = first;
+    for (size_t i = 0; i < gap_count; ++i) {
+        ids[i + 1] = ids[i] + static_cast<int>(gaps[i]) + 1;
+    }
+}
+
+size_t DifferencePositionsScalar(const int* lhs, size_t lhs_count, const int* rhs, size_t rhs_count,
+    uint32_t* positions, size_t first = 0, size_t rhs_first = 0, size_t position_count = 0) {
+    size_t j = rhs_first;
+    for (size_t i = first; i < lhs_count; ++i) {
+        while (j < rhs_count && rhs[j] < lhs[i]) {
+            ++j;
+        }
+        if (j == rhs_count || rhs[j] != lhs[i]) {
+            positions[position_count++] = static_cast<uint32_t>(i);
+        }
+    }
+    return position_count;
+}
+
+size_t IntersectSortedScalar(const uint32_t* lhs, size_t lhs_count, const uint32_t* rhs, size_t rhs_count, uint32_t* out) {
+    return set_intersection(lhs, lhs + lhs_count, rhs, rhs + rhs_count, out) - out;
+}
+
+#ifdef POSTING_KERNELS_X86
+
+// позиции нулевых битов маски из width младших
+inline size_t AppendClearBits(unsigned mask, unsigned width, size_t first, uint32_t* positions, size_t position_count) {
+    for (unsigned bit = 0; bit < width; ++bit) {
+        if ((mask & (1u << bit)) == 0) {
+            positions[position_count++] = static_cast<uint32_t>(first + bit);
+        }
+    }
+    return position_count;
+}
+
+// сужает диапазон бинарным поиском без ветвлений до 8 элементов и возвращает начало окна из 8 элементов,
+// в котором лежит ответ; все элементы до окна меньше value. count должен быть не меньше 8
+inline const int* NarrowToWindow(const int* values, size_t count, int value) {
+    const int* base = values;
+    size_t size = count;
+    while (size > 8) {
+        const size_t half = size / 2;
+        base = base[half] < value ? base + half : base;
+        size -= half;
+    }
+    return min(base, values + count - 8);
+}
+
+TARGET_SSE4 size_t CountLessSse4(const int* values, size_t count, int value) {
+    if (count < 8) {
+        return CountLessScalar(values, count, value);
+    }
+    const int* window = NarrowToWindow(values, count, value);
+    const __m128i needle = _mm_set1_epi32(value);
+    const __m128i low = _mm_cmpgt_epi32(needle, _mm_loadu_si128(reinterpret_cast<const __m128i*>(window)));
+    const __m128i high = _mm_cmpgt_epi32(needle, _mm_loadu_si128(reinterpret_cast<const __m128i*>(window + 4)));
+    const unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(low)) | (_mm_movemask_ps(_mm_castsi128_ps(high)) << 4);
+    return (window - values) + bitset<8>(mask).count();
+}
+
+TARGET_AVX2 size_t CountLessAvx2(const int* values, size_t count, int value) {
+    if (count < 8) {
+        return CountLessScalar(values, count, value);
+    }
+    const int* window = NarrowToWindow(values, count, value);
+    const __m256i less = _mm256_cmpgt_epi32(_mm256_set1_epi32(value), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(window)));
+    return (window - values) + bitset<8>(_mm256_movemask_ps(_mm256_castsi256_ps(less))).count();
+}
+
+TARGET_SSE4 void PrefixSumGapsSse4(int first, const uint32_t* gaps, size_t gap_count, int* ids) {
+    ids[0] = first;
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(first);
+    size_t i = 0;
+    for (; i + 4 <= gap_count; i += 4) {
+        __m128i sums = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(gaps + i)), one);
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+        sums = _mm_add_epi32(sums, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(ids + i + 1), sums);
+        carry = _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    for (; i < gap_count; ++i) {
+        ids[i + 1] = ids[i] + static_cast<int>(gaps[i]) + 1;
+    }
+}
+
+TARGET_AVX2 void PrefixSumGapsAvx2(int first, const uint32_t* gaps, size_t gap_count, int* ids) {
+    ids[0] = first;
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i last_lane = _mm256_set1_epi32(7);
+    __m256i carry = _mm256_set1_epi32(first);
+    size_t i = 0;
+    for (; i + 8 <= gap_count; i += 8) {
+        __m256i sums = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(gaps + i)), one);
+        // суммы внутри 128-битных половин, затем последняя сумма младшей половины добавляется к старшей
+        sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 4));
+        sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 8));
+        const __m256i low_total = _mm256_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+        sums = _mm256_add_epi32(sums, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+        sums = _mm256_add_epi32(sums, carry);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ids + i + 1), sums);
+        carry = _mm256_permutevar8x32_epi32(sums, last_lane);
+    }
+    for (; i < gap_count; ++i) {
+        ids[i + 1] = ids[i] + static_cast<int>(gaps[i]) + 1;
+    }
+}
+
+// lhs сравнивается кусками, с каждым куском сравниваются только элементы rhs из его диапазона
+TARGET_SSE4 size_t DifferencePositionsSse4(const int* lhs, size_t lhs_count, const int* rhs, size_t rhs_count, uint32_t* positions) {
+    size_t position_count = 0;
+    size_t j = 0;
+    size_t i = 0;
+    for (; i + 4 <= lhs_count; i += 4) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+        while (j < rhs_count && rhs[j] < lhs[i]) {
+            ++j;
+        }
+        __m128i equal = _mm_setzero_si128();
+        for (; j < rhs_count && rhs[j] <= lhs[i + 3]; ++j) {
+            equal = _mm_or_si128(equal, _mm_cmpeq_epi32(block, _mm_set1_epi32(rhs[j])));
+        }
+        position_count = AppendClearBits(_mm_movemask_ps(_mm_castsi128_ps(equal)), 4, i, positions, position_count);
+    }
+    return DifferencePositionsScalar(lhs, lhs_count, rhs, rhs_count, positions, i, j, position_count);
+}
+
+TARGET_AVX2 size_t DifferencePositionsAvx2(const int* lhs, size_t lhs_count, const int* rhs, size_t rhs_count, uint32_t* positions) {
+    size_t position_count = 0;
+    size_t j = 0;
+    size_t i = 0;
+    for (; i + 8 <= lhs_count; i += 8) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + i));
+        while (j < rhs_count && rhs[j] < lhs[i]) {
+            ++j;
+        }
+        __m256i equal = _mm256_setzero_si256();
+        for (; j < rhs_count && rhs[j] <= lhs[i + 7]; ++j) {
+            equal = _mm256_or_si256(equal, _mm256_cmpeq_epi32(block, _mm256_set1_epi32(rhs[j])));
+        }
+        position_count = AppendClearBits(_mm256_movemask_ps(_mm256_castsi256_ps(equal)), 8, i, positions, position_count);
+    }
+    return DifferencePositionsScalar(lhs, lhs_count, rhs, rhs_count, positions, i, j, position_count);
+}
+
+// каждый элемент lhs ищется в rhs: пропускаем куски rhs, которые целиком меньше него, и сравниваем с куском разом
+TARGET_SSE4 size_t IntersectSortedSse4(const uint32_t* lhs, size_t lhs_count, const uint32_t* rhs, size_t rhs_count, uint32_t* out) {
+    size_t count = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < lhs_count; ++i) {
+        const uint32_t value = lhs[i];
+        while (j + 4 <= rhs_count && rhs[j + 3] < value) {
+            j += 4;
+        }
+        if (j + 4 <= rhs_count) {
+            const __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + j)),
+                _mm_set1_epi32(static_cast<int>(value)));
+            if (!_mm_testz_si128(equal, equal)) {
+                out[count++] = value;
+            }
+            continue;
+        }
+        while (j < rhs_count && rhs[j] < value) {
+            ++j;
+        }
+        if (j < rhs_count && rhs[j] == value) {
+            out[count++] = value;
+        }
+    }
+    return count;
+}
+
+TARGET_AVX2 size_t IntersectSortedAvx2(const uint32_t* lhs, size_t lhs_count, const uint32_t* rhs, size_t rhs_count, uint32_t* out) {
+    size_t count = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < lhs_count; ++i) {
+        const uint32_t value = lhs[i];
+        while (j + 8 <= rhs_count && rhs[j + 7] < value) {
+            j += 8;
+        }
+        if (j + 8 <= rhs_count) {
+            const __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + j)),
+                _mm256_set1_epi32(static_cast<int>(value)));
+            if (!_mm256_testz_si256(equal, equal)) {
+                out[count++] = value;
+            }
+            continue;
+        }
+        while (j < rhs_count && rhs[j] < value) {
+            ++j;
+        }
+        if (j < rhs_count && rhs[j] == value) {
+            out[count++] = value;
+        }
+    }
+    return count;
+}
+
+SimdLevel DetectSimdLevel() {
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SimdLevel::SSE4;
+    }
+#else
+    int info[4];
+    __cpuid(info, 1);
+    const bool sse4 = (info[2] & (1 << 19)) != 0;
+    // AVX2 можно использовать, только если ОС сохраняет регистры YMM
+    const bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    if (avx && (info[1] & (1 << 5)) != 0) {
+        return SimdLevel::AVX2;
+    }
+    if (sse4) {
+        return SimdLevel::SSE4;
+    }
+#endif
+    return SimdLevel::SCALAR;
+}
+
+#else
+
+SimdLevel DetectSimdLevel() {
+    return SimdLevel::SCALAR;
+}
+
+#endif
+
+const SimdLevel supported_simd_level = DetectSimdLevel();
+atomic<SimdLevel> simd_level{ supported_simd_level };
+
+} // namespace
+
+SimdLevel GetSimdLevel() {
+    return simd_level.load(memory_order_relaxed);
+}
+
+void SetSimdLevel(SimdLevel level) {
+    simd_level.store(min(level, supported_simd_level), memory_order_relaxed);
+}
+
+size_t CountLess(const int* values, size_t count, int value) {
+#ifdef POSTING_KERNELS_X86
+    switch (GetSimdLevel()) {
+    case SimdLevel::AVX2:
+        return CountLessAvx2(values, count, value);
+    case SimdLevel::SSE4:
+        return CountLessSse4(values, count, value);
+    default:
+        break;
+    }
+#endif
+    return CountLessScalar(values, count, value);
+}
+
+void PrefixSumGaps(int first, const uint32_t* gaps, size_t gap_count, int* ids) {
+#ifdef POSTING_KERNELS_X86
+    switch (GetSimdLevel()) {
+    case SimdLevel::AVX2:
+        return PrefixSumGapsAvx2(first, gaps, gap_count, ids);
+    case SimdLevel::SSE4:
+        return PrefixSumGapsSse4(first, gaps, gap_count, ids);
+    default:
+        break;
+    }
+#endif
+    PrefixSumGapsScalar(first, gaps, gap_count, ids);
+}
+
+size_t DifferencePositions(const int* lhs, size_t lhs_count, const int* rhs, size_t rhs_count, uint32_t* positions) {
+#ifdef POSTING_KERNELS_X86
+    switch (GetSimdLevel()) {
+    case SimdLevel::AVX2:
+        return DifferencePositionsAvx2(lhs, lhs_count, rhs, rhs_count, positions);
+    case SimdLevel::SSE4:
+        return DifferencePositionsSse4(lhs, lhs_count, rhs, rhs_count, positions);
+    default:
+        break;
+    }
+#endif
+    return DifferencePositionsScalar(lhs, lhs_count, rhs, rhs_count, positions);
+}
+
+size_t IntersectSorted(const uint32_t* lhs, size_t lhs_count, const uint32_t* rhs, size_t rhs_count, uint32_t* out) {
+#ifdef POSTING_KERNELS_X86
+    switch (GetSimdLevel()) {
+    case SimdLevel::AVX2:
+        return IntersectSortedAvx2(lhs, lhs_count, rhs, rhs_count, out);
+    case SimdLevel::SSE4:
+        return IntersectSortedSse4(lhs, lhs_count, rhs, rhs_count, out);
+    default:
+        break;
+    }
+#endif
+    return IntersectSortedScalar(lhs, lhs_count, rhs, rhs_count, out);
+}
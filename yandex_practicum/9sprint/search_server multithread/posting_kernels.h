@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// векторные ядра для работы с отсортированными списками номеров.
+// у каждого ядра есть скалярная версия и версии SSE4.1 и AVX2, подходящая выбирается при запуске по процессору
+
+enum class SimdLevel {
+    SCALAR,
+    SSE4,
+    AVX2,
+};
+
+// уровень, на котором сейчас работают ядра
+SimdLevel GetSimdLevel();
+// ограничивает уровень сверху (для сравнения версий в бенчмарках), выше поддерживаемого процессором не поднимает
+void SetSimdLevel(SimdLevel level);
+
+// число элементов отсортированного массива меньше value, то есть позиция lower_bound
+size_t CountLess(const int* values, size_t count, int value);
+
+// восстанавливает номера по разностям: ids[0] = first, ids[i + 1] = ids[i] + gaps[i] + 1
+void PrefixSumGaps(int first, const uint32_t* gaps, size_t gap_count, int* ids);
+
+// записывает в positions позиции элементов lhs, которых нет в rhs, возвращает их число
+size_t DifferencePositions(const int* lhs, size_t lhs_count, const int* rhs, size_t rhs_count, uint32_t* positions);
+
+// записывает в out общие элементы двух отсортированных массивов без повторов, возвращает их число
+size_t IntersectSorted(const uint32_t* lhs, size_t lhs_count, const uint32_t* rhs, size_t rhs_count, uint32_t* out);
@@ -0,0 +1,180 @@
+#include "posting_list.h"
+#include "posting_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+void PostingList::Add(int document_id, double term_freq) {
+    std::vector<int>& document_ids = document_ids_.Mutable();
+    std::vector<double>& term_freqs = term_freqs_.Mutable();
+    std::vector<int>& block_last_ids = block_last_ids_.Mutable();
+    std::vector<double>& block_max_term_freqs = block_max_term_freqs_.Mutable();
+    // обычно документы добавляются по возрастанию id, поэтому сначала проверяем хвост
+    if (document_ids.empty() || document_ids.back() < document_id) {
+        document_ids.push_back(document_id);
+        term_freqs.push_back(term_freq);
+        max_term_freq_ = std::max(max_term_freq_, term_freq);
+        if (block_last_ids.size() * BLOCK_SIZE < document_ids.size()) {
+            block_last_ids.push_back(document_id);
+            block_max_term_freqs.push_back(term_freq);
+        }
+        else {
+            block_last_ids.back() = document_id;
+            block_max_term_freqs.back() = std::max(block_max_term_freqs.back(), term_freq);
+        }
+        ++document_freq_;
+        UpdateLogDocumentFreq();
+        return;
+    }
+    auto it = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    const auto pos = it - document_ids.begin();
+    if (*it == document_id) {
+        term_freqs[pos] += term_freq;
+        max_term_freq_ = std::max(max_term_freq_, term_freqs[pos]);
+        block_max_term_freqs[pos / BLOCK_SIZE] = std::max(block_max_term_freqs[pos / BLOCK_SIZE], term_freqs[pos]);
+        return;
+    }
+    document_ids.insert(it, document_id);
+    term_freqs.insert(term_freqs.begin() + pos, term_freq);
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    UpdateBlocks(pos);
+    ++document_freq_;
+    UpdateLogDocumentFreq();
+}
+
+void PostingList::MarkRemoved(size_t document_count) {
+    document_freq_ -= document_count;
+    UpdateLogDocumentFreq();
+}
+
+void PostingList::EraseDocuments(const Bitmap& removed) {
+    if (document_ids_.size() == document_freq_) {
+        return;
+    }
+    std::vector<int>& document_ids = document_ids_.Mutable();
+    std::vector<double>& term_freqs = term_freqs_.Mutable();
+    size_t kept = 0;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (!removed.Test(document_ids[i])) {
+            document_ids[kept] = document_ids[i];
+            term_freqs[kept] = term_freqs[i];
+            ++kept;
+        }
+    }
+    document_ids.resize(kept);
+    term_freqs.resize(kept);
+    document_ids.shrink_to_fit();
+    term_freqs.shrink_to_fit();
+    max_term_freq_ = term_freqs.empty() ? 0.0 : *std::max_element(term_freqs.begin(), term_freqs.end());
+    UpdateBlocks(0);
+    block_last_ids_.Mutable().shrink_to_fit();
+    block_max_term_freqs_.Mutable().shrink_to_fit();
+}
+
+void PostingList::Renumber(const std::vector<int>& new_ordinals) {
+    for (int& document_id : document_ids_.Mutable()) {
+        document_id = new_ordinals[document_id];
+    }
+    for (int& last_id : block_last_ids_.Mutable()) {
+        last_id = new_ordinals[last_id];
+    }
+}
+
+bool PostingList::Contains(int document_id) const {
+    // блок ищем по последним номерам блоков, внутри блока номер ищется векторно
+    const size_t block = std::lower_bound(block_last_ids_.begin(), block_last_ids_.end(), document_id) - block_last_ids_.begin();
+    if (block == block_last_ids_.size()) {
+        return false;
+    }
+    const size_t first = block * BLOCK_SIZE;
+    const size_t count = std::min(BLOCK_SIZE, document_ids_.size() - first);
+    const size_t pos = first + CountLess(document_ids_.data() + first, count, document_id);
+    return document_ids_[pos] == document_id;
+}
+
+PostingList::SnapshotEntry PostingList::Save(SnapshotWriter& writer) const {
+    return { writer.Write(document_ids_), writer.Write(term_freqs_), writer.Write(block_last_ids_),
+        writer.Write(block_max_term_freqs_), document_freq_, max_term_freq_ };
+}
+
+void PostingList::Load(const SnapshotReader& reader, const SnapshotEntry& entry, size_t ordinal_count) {
+    document_ids_ = reader.Array<int>(entry.document_ids);
+    term_freqs_ = reader.Array<double>(entry.term_freqs);
+    block_last_ids_ = reader.Array<int>(entry.block_last_ids);
+    block_max_term_freqs_ = reader.Array<double>(entry.block_max_term_freqs);
+    const size_t size = document_ids_.size();
+    if (term_freqs_.size() != size || block_last_ids_.size() != (size + BLOCK_SIZE - 1) / BLOCK_SIZE
+        || block_max_term_freqs_.size() != block_last_ids_.size() || entry.document_freq > size
+        || !(entry.max_term_freq >= 0.0 && entry.max_term_freq <= std::numeric_limits<double>::max())) {
+        throw std::runtime_error("Snapshot file is damaged");
+    }
+    // последние номера блоков растут и меньше числа документов, тогда и номера внутри блоков, если Check
+    // подтвердит их порядок, попадают в [0, ordinal_count)
+    for (size_t block = 0; block < block_last_ids_.size(); ++block) {
+        if (block_last_ids_[block] < 0 || static_cast<size_t>(block_last_ids_[block]) >= ordinal_count
+            || (block > 0 && block_last_ids_[block] <= block_last_ids_[block - 1])
+            || !(block_max_term_freqs_[block] > 0.0 && block_max_term_freqs_[block] <= entry.max_term_freq)) {
+            throw std::runtime_error("Snapshot file is damaged");
+        }
+    }
+    document_freq_ = entry.document_freq;
+    max_term_freq_ = entry.max_term_freq;
+    UpdateLogDocumentFreq();
+}
+
+void PostingList::Check() const {
+    for (size_t i = 0; i < document_ids_.size(); ++i) {
+        const size_t block = i / BLOCK_SIZE;
+        const bool block_end = i + 1 == document_ids_.size() || (i + 1) % BLOCK_SIZE == 0;
+        if ((i == 0 ? document_ids_[i] < 0 : document_ids_[i] <= document_ids_[i - 1])
+            || (block_end && document_ids_[i] != block_last_ids_[block])
+            || !(term_freqs_[i] > 0.0 && term_freqs_[i] <= block_max_term_freqs_[block])) {
+            throw std::runtime_error("Snapshot file is damaged");
+        }
+    }
+}
+
+size_t PostingList::size() const {
+    return document_ids_.size();
+}
+
+bool PostingList::empty() const {
+    return document_ids_.empty();
+}
+
+const MappedArray<int>& PostingList::DocumentIds() const {
+    return document_ids_;
+}
+
+const MappedArray<double>& PostingList::TermFreqs() const {
+    return term_freqs_;
+}
+
+void PostingList::UpdateLogDocumentFreq() {
+    log_document_freq_ = std::log(static_cast<double>(document_freq_));
+}
+
+void PostingList::UpdateBlocks(size_t pos) {
+    std::vector<int>& block_last_ids = block_last_ids_.Mutable();
+    std::vector<double>& block_max_term_freqs = block_max_term_freqs_.Mutable();
+    const size_t block_count = (document_ids_.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    block_last_ids.resize(block_count);
+    block_max_term_freqs.resize(block_count);
+    for (size_t block = pos / BLOCK_SIZE; block < block_count; ++block) {
+        const size_t first = block * BLOCK_SIZE;
+        const size_t last = std::min(first + BLOCK_SIZE, document_ids_.size());
+        block_last_ids[block] = document_ids_[last - 1];
+        block_max_term_freqs[block] = *std::max_element(term_freqs_.begin() + first, term_freqs_.begin() + last);
+    }
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings, int first_ordinal, int last_ordinal)
+    : postings_(&postings)
+    , document_ids_(postings.document_ids_.data())
+    , term_freqs_(postings.term_freqs_.data()) {
+    const int* end = document_ids_ + postings.document_ids_.size();
+    position_ = std::lower_bound(document_ids_, end, first_ordinal);
+    last_ = std::lower_bound(position_, end, last_ordinal);
+    block_ = static_cast<size_t>(position_ - document_ids_) / BLOCK_SIZE;
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "bitmap.h"
+#include "mapped_array.h"
+#include "snapshot_file.h"
+
+// ищет в отсортированном диапазоне первый номер не меньше ordinal:
+// сначала шагами удваивающейся длины, затем бинарным поиском внутри последнего шага
+inline const int* SeekOrdinal(const int* first, const int* last, int ordinal) {
+    size_t step = 1;
+    while (step < static_cast<size_t>(last - first) && first[step] < ordinal) {
+        first += step;
+        step *= 2;
+    }
+    const int* bound = step < static_cast<size_t>(last - first) ? first + step + 1 : last;
+    return std::lower_bound(first, bound, ordinal);
+}
+
+// список вхождений слова: порядковые номера документов по возрастанию и параллельный массив частот.
+// список поделён на блоки по BLOCK_SIZE вхождений, для каждого блока хранится последний номер и наибольшая частота
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // описание списка в снимке индекса
+    struct SnapshotEntry {
+        SnapshotArray document_ids;
+        SnapshotArray term_freqs;
+        SnapshotArray block_last_ids;
+        SnapshotArray block_max_term_freqs;
+        uint64_t document_freq;
+        double max_term_freq;
+    };
+
+    // добавляет частоту к документу, сохраняя порядок номеров
+    void Add(int document_id, double term_freq);
+    // document_count документов из списка удалены, но их вхождения остаются в списке до EraseDocuments:
+    // уменьшается только число документов со словом, по которому считается IDF
+    void MarkRemoved(size_t document_count = 1);
+    // убирает из списка вхождения документов, отмеченных в removed
+    void EraseDocuments(const Bitmap& removed);
+    // переводит номера документов в new_ordinals[номер]; удалённых документов в списке быть не должно,
+    // новые номера должны сохранять порядок
+    void Renumber(const std::vector<int>& new_ordinals);
+    bool Contains(int document_id) const;
+
+    SnapshotEntry Save(SnapshotWriter& writer) const;
+    // заменяет список сохранённым в снимке, массивы смотрят в страницы снимка. проверяются размеры
+    // и описания блоков: номера последних документов блоков должны быть меньше ordinal_count
+    void Load(const SnapshotReader& reader, const SnapshotEntry& entry, size_t ordinal_count);
+    // проверяет вхождения списка из снимка, бросает runtime_error, если они не сходятся с описаниями блоков
+    void Check() const;
+
+    // число вхождений в списке, вместе с ещё не убранными удалёнными документами
+    size_t size() const;
+    bool empty() const;
+    // число неудалённых документов со словом
+    size_t DocumentFreq() const {
+        return document_freq_;
+    }
+
+    const MappedArray<int>& DocumentIds() const;
+    const MappedArray<double>& TermFreqs() const;
+
+    // логарифм DocumentFreq, пересчитывается при его изменении
+    double LogDocumentFreq() const {
+        return log_document_freq_;
+    }
+
+    // наибольшая частота слова среди документов списка, нужна для верхней оценки релевантности;
+    // удалённые документы учитываются до EraseDocuments, так что это оценка сверху
+    double MaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    size_t BlockCount() const {
+        return block_last_ids_.size();
+    }
+    const MappedArray<int>& BlockLastIds() const {
+        return block_last_ids_;
+    }
+    const MappedArray<double>& BlockMaxTermFreqs() const {
+        return block_max_term_freqs_;
+    }
+
+    // курсор по вхождениям с номерами из [first_ordinal, last_ordinal)
+    class Cursor {
+    public:
+        Cursor(const PostingList& postings, int first_ordinal, int last_ordinal);
+
+        bool AtEnd() const {
+            return position_ == last_;
+        }
+        int Ordinal() const {
+            return *position_;
+        }
+        double TermFreq() const {
+            return term_freqs_[position_ - document_ids_];
+        }
+        void Next() {
+            ++position_;
+        }
+        // переходит к первому вхождению с номером не меньше ordinal
+        void Seek(int ordinal) {
+            position_ = SeekOrdinal(position_, last_, ordinal);
+        }
+
+        // вхождения читаются кусками: у несжатого списка кусок - весь оставшийся диапазон
+        const int* ChunkOrdinals() const {
+            return position_;
+        }
+        size_t ChunkSize() const {
+            return last_ - position_;
+        }
+        double ChunkTermFreq(size_t i) const {
+            return term_freqs_[position_ - document_ids_ + i];
+        }
+        void NextChunk() {
+            position_ = last_;
+        }
+
+        // переходит к блоку, в который попал бы ordinal, false если таких блоков нет;
+        // позиция курсора при этом не меняется
+        bool SeekBlock(int ordinal) {
+            while (block_ < postings_->BlockCount() && postings_->block_last_ids_[block_] < ordinal) {
+                ++block_;
+            }
+            return block_ < postings_->BlockCount();
+        }
+        int BlockLastOrdinal() const {
+            return postings_->block_last_ids_[block_];
+        }
+        double BlockMaxTermFreq() const {
+            return postings_->block_max_term_freqs_[block_];
+        }
+
+    private:
+        const PostingList* postings_;
+        const int* document_ids_;
+        const double* term_freqs_;
+        const int* position_;
+        const int* last_;
+        size_t block_;
+    };
+
+private:
+    void UpdateLogDocumentFreq();
+    // пересчитывает описания блоков, начиная с блока, в который попадает позиция pos
+    void UpdateBlocks(size_t pos);
+
+    MappedArray<int> document_ids_;
+    MappedArray<double> term_freqs_;
+    size_t document_freq_ = 0;
+    double log_document_freq_ = 0.0;
+    double max_term_freq_ = 0.0;
+    MappedArray<int> block_last_ids_;
+    MappedArray<double> block_max_term_freqs_;
+};
@@ -0,0 +1,35 @@
+#include "process_memory.h"
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+size_t GetResidentBytes() {
+    // второе поле /proc/self/statm - resident size в страницах
+    ifstream statm("/proc/self/statm"s);
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t GetPeakResidentBytes() {
+    // строка "VmHWM:   123456 kB" в /proc/self/status
+    ifstream status("/proc/self/status"s);
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:"s) == 0) {
+            return stoull(line.substr(6)) * 1024;
+        }
+    }
+    return 0;
+}
+
+bool ResetPeakResidentBytes() {
+    // "5" в clear_refs сбрасывает VmHWM до текущего resident size
+    ofstream clear_refs("/proc/self/clear_refs"s);
+    return static_cast<bool>(clear_refs << '5' << flush);
+}
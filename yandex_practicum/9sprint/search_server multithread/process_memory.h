@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+
+// память процесса по /proc/self: без /proc функции возвращают 0 и false
+
+// resident size процесса в байтах
+size_t GetResidentBytes();
+// наибольший resident size (VmHWM) с запуска процесса или с последнего ResetPeakResidentBytes
+size_t GetPeakResidentBytes();
+// сбрасывает пик до текущего resident size; false, если ядро этого не позволяет
+bool ResetPeakResidentBytes();
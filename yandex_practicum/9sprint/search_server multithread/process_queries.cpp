@@ -1,7 +1,10 @@
 #include "process_queries.h"
 
-std::vector<std::vector<Document>> ProcessQueries(
-    const SearchServer& search_server,
+namespace {
+
+template <typename Server>
+std::vector<std::vector<Document>> ProcessQueriesBy(
+    const Server& search_server,
     const std::vector<std::string>& queries) {
 
     std::vector<std::vector<Document>> result(queries.size());
@@ -11,11 +14,12 @@ std::vector<std::vector<Document>> ProcessQueries(
     return result;
 }
 
-std::vector<Document> ProcessQueriesJoined(
-    const SearchServer& search_server,
+template <typename Server>
+std::vector<Document> ProcessQueriesJoinedBy(
+    const Server& search_server,
     const std::vector<std::string>& queries) {
 
-    auto documents = ProcessQueries(search_server, queries);
+    auto documents = ProcessQueriesBy(search_server, queries);
     const int SIZE = std::transform_reduce(std::execution::par, documents.begin(), documents.end(), 0,
         std::plus<>(), [](std::vector<Document>& doc) { return doc.size(); });
     std::vector<Document> result(SIZE);
@@ -28,3 +32,28 @@ std::vector<Document> ProcessQueriesJoined(
     return result;   
 }
 
+} // namespace
+
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return ProcessQueriesBy(search_server, queries);
+}
+
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return ProcessQueriesJoinedBy(search_server, queries);
+}
+
+std::vector<std::vector<Document>> ProcessQueries(
+    const SegmentedSearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return ProcessQueriesBy(search_server, queries);
+}
+
+std::vector<Document> ProcessQueriesJoined(
+    const SegmentedSearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return ProcessQueriesJoinedBy(search_server, queries);
+}
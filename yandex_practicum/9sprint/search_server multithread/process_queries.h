@@ -1,5 +1,6 @@
 #pragma once
 #include "search_server.h"
+#include "segmented_search_server.h"
 #include <vector>
 #include <algorithm>
 #include <numeric>
@@ -13,3 +14,12 @@ std::vector<std::vector<Document>> ProcessQueries(
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
+
+// каждый запрос читает одну опубликованную версию индекса, поэтому запись может идти параллельно
+std::vector<std::vector<Document>> ProcessQueries(
+    const SegmentedSearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+std::vector<Document> ProcessQueriesJoined(
+    const SegmentedSearchServer& search_server,
+    const std::vector<std::string>& queries);
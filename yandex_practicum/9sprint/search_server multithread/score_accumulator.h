@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// накопитель релевантности: плотный массив по порядковым номерам документов
+// и список затронутых документов, чтобы очищать его за O(затронутых), а не за O(N).
+// Score - double для точных оценок или целый тип для квантованных вкладов
+template <typename Score>
+class ScoreAccumulator {
+public:
+    // очищает результаты прошлого запроса и готовит массивы под document_count документов
+    void Reset(size_t document_count);
+
+    void Add(int ordinal, Score value) {
+        if (!touched_flags_[ordinal]) {
+            touched_flags_[ordinal] = true;
+            touched_.push_back(ordinal);
+        }
+        scores_[ordinal] += value;
+    }
+
+    Score GetScore(int ordinal) const {
+        return scores_[ordinal];
+    }
+
+    // документы в порядке первого добавления
+    const std::vector<int>& Touched() const {
+        return touched_;
+    }
+
+private:
+    std::vector<Score> scores_;
+    std::vector<uint8_t> touched_flags_;
+    std::vector<int> touched_;
+};
+
+template <typename Score>
+void ScoreAccumulator<Score>::Reset(size_t document_count) {
+    for (const int ordinal : touched_) {
+        scores_[ordinal] = Score{};
+        touched_flags_[ordinal] = false;
+    }
+    touched_.clear();
+    if (scores_.size() < document_count) {
+        scores_.resize(document_count, Score{});
+        touched_flags_.resize(document_count, false);
+    }
+}
@@ -1,39 +1,363 @@
 #include "search_server.h"
 #include <cmath>
+#include <fstream>
+#include "index_file.h"
+#include "memtable.h"
 
 using namespace std;
 
-SearchServer::SearchServer(const string& stop_words_text)
+namespace {
+
+//    
+struct SnapshotRoot {
+    uint32_t posting_layout;
+    SnapshotStrings stop_words;
+    TermDictionary::SnapshotEntry terms;
+    SnapshotArray postings; //        
+    SnapshotArray removed_terms;
+    DocumentAttributes::SnapshotEntry documents;
+    ForwardIndex::SnapshotEntry forward_index;
+    SnapshotArray document_ids; // id   
+    SnapshotArray document_ordinals; //   
+};
+
+} // namespace
+
+SearchServer::SearchServer(const string& stop_words_text, PostingLayout posting_layout, DocumentTextStorage text_storage)
     : SearchServer(
-        SplitIntoWords((stop_words_text)))  // Invoke delegating constructor from string container
+        SplitIntoWords((stop_words_text)), posting_layout, text_storage)  // Invoke delegating constructor from string container
 {
 }
-SearchServer::SearchServer(string_view stop_words_text)
+SearchServer::SearchServer(string_view stop_words_text, PostingLayout posting_layout, DocumentTextStorage text_storage)
     : SearchServer(
-        SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+        SplitIntoWords(stop_words_text), posting_layout, text_storage)  // Invoke delegating constructor from string container
 {
 }
 
+SearchServer::SearchServer(shared_ptr<const set<string, less<>>> stop_words, PostingLayout posting_layout,
+    DocumentTextStorage text_storage)
+    : stop_words_(move(stop_words))
+    , posting_layout_(posting_layout)
+    , documents_(text_storage == DocumentTextStorage::KEEP) {
+}
+
 void SearchServer::AddDocument(int document_id, string_view text, DocumentStatus status,
     const vector<int>& ratings) {
     using namespace std;
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_to_ordinal_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
-    document_text_.push_back(string(text));
-    auto words = SplitIntoWordsNoStop(document_text_.back());
+    //     ,       
+    auto words = SplitIntoWordsNoStop(text);
 
     const double inv_word_count = 1.0 / words.size();
-    for (const auto& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        word_freq_[document_id][word] += inv_word_count;
+    const int ordinal = documents_.Add(document_id, ComputeAverageRating(ratings), status, inv_word_count, text);
+    vector<TermId> term_ids;
+    term_ids.reserve(words.size());
+    VisitPostings([&](auto& index) {
+        for (const auto& word : words) {
+            const TermId term_id = terms_.Intern(word);
+            if (term_id == index.size()) {
+                index.emplace_back();
+            }
+            index[term_id].Add(ordinal, inv_word_count);
+            term_ids.push_back(term_id);
+        }
+        });
+    forward_index_.Add(move(term_ids), inv_word_count);
+    document_to_ordinal_.emplace(document_id, ordinal);
+    document_ids_.insert(document_id);
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+void SearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    AddDocumentBatch(std::execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const std::execution::sequenced_policy& policy, const vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents);
+}
+
+void SearchServer::AddDocuments(const std::execution::parallel_policy& policy, const vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents);
+}
+
+void SearchServer::AppendDocuments(const SearchServer& source, const Bitmap& excluded) {
+    using namespace std;
+    //   source    ,       
+    vector<TermId> term_map(source.terms_.size(), TermDictionary::NO_TERM);
+    vector<TermId> term_ids;
+    const auto& word_weights = source.documents_.GetWordWeights();
+    for (int source_ordinal = 0; source_ordinal < static_cast<int>(source.documents_.size()); ++source_ordinal) {
+        if (source.documents_.IsRemoved(source_ordinal)
+            || (static_cast<size_t>(source_ordinal) < excluded.size() && excluded.Test(source_ordinal))) {
+            continue;
+        }
+        const int document_id = source.documents_.GetId(source_ordinal);
+        if (document_to_ordinal_.count(document_id) > 0) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        const double word_weight = word_weights[source_ordinal];
+        const auto document_terms = source.forward_index_.Get(source_ordinal);
+        //  - word_weight,    ,    ,
+        //      ,   AddDocument
+        term_ids.clear();
+        for (size_t i = 0; i < document_terms.size; ++i) {
+            TermId& term_id = term_map[document_terms.term_ids[i]];
+            if (term_id == TermDictionary::NO_TERM) {
+                term_id = terms_.Intern(source.terms_.GetTerm(document_terms.term_ids[i]));
+            }
+            const long long occurrences = llround(document_terms.term_freqs[i] / word_weight);
+            term_ids.insert(term_ids.end(), static_cast<size_t>(occurrences), term_id);
+        }
+        AppendDocument(document_id, source.documents_.GetRating(source_ordinal), source.documents_.GetStatus(source_ordinal),
+            word_weight, source.documents_.GetText(source_ordinal), term_ids);
+    }
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+void SearchServer::AppendDocuments(const MemTable& source, size_t ordinal_count, const Bitmap& excluded) {
+    using namespace std;
+    //       ,       
+    unordered_map<const MemTable::Term*, TermId> term_map;
+    vector<TermId> term_ids;
+    for (int source_ordinal = 0; source_ordinal < static_cast<int>(ordinal_count); ++source_ordinal) {
+        if (static_cast<size_t>(source_ordinal) < excluded.size() && excluded.Test(source_ordinal)) {
+            continue;
+        }
+        const MemTable::DocumentEntry& document = source.GetDocument(source_ordinal);
+        if (document_to_ordinal_.count(document.id) > 0) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        term_ids.clear();
+        for (const auto& [term, occurrences] : document.terms) {
+            auto [term_it, inserted] = term_map.emplace(term, TermDictionary::NO_TERM);
+            if (inserted) {
+                term_it->second = terms_.Intern(term->GetText());
+            }
+            term_ids.insert(term_ids.end(), static_cast<size_t>(occurrences), term_it->second);
+        }
+        AppendDocument(document.id, document.rating, document.status, document.word_weight, document.text, term_ids);
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+void SearchServer::AppendDocument(int document_id, int rating, DocumentStatus status, double word_weight, string_view text,
+    const vector<TermId>& term_ids) {
+    const int ordinal = documents_.Add(document_id, rating, status, word_weight, text);
+    VisitPostings([&](auto& index) {
+        for (const TermId term_id : term_ids) {
+            if (term_id == index.size()) {
+                index.emplace_back();
+            }
+            index[term_id].Add(ordinal, word_weight);
+        }
+        });
+    forward_index_.Add(term_ids, word_weight);
+    document_to_ordinal_.emplace_hint(document_to_ordinal_.end(), document_id, ordinal);
     document_ids_.insert(document_id);
 }
 
+SearchServer SearchServer::LoadIndex(const string& path, PostingLayout posting_layout, DocumentTextStorage text_storage) {
+    using namespace std;
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    //         ,       
+    const uint64_t file_size = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+    const auto damaged = [&path]() {
+        return runtime_error("Index file is damaged: "s + path);
+    };
+    const auto read_count = [&]() {
+        const uint64_t count = ReadValue<uint64_t>(in);
+        if (count > file_size) {
+            throw damaged();
+        }
+        return static_cast<size_t>(count);
+    };
+    if (ReadValue<uint32_t>(in) != INDEX_FILE_MAGIC || ReadValue<uint32_t>(in) != INDEX_FILE_VERSION) {
+        throw runtime_error("Unsupported index file "s + path);
+    }
+    vector<string> stop_words(read_count());
+    for (string& stop_word : stop_words) {
+        stop_word = ReadString(in, file_size);
+    }
+    SearchServer server(stop_words, posting_layout, text_storage);
+
+    //      ,      
+    const size_t term_count = read_count();
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        if (server.terms_.Intern(ReadString(in, file_size)) != term_id) {
+            throw damaged();
+        }
+    }
+    server.VisitPostings([term_count](auto& index) {
+        index.resize(term_count);
+        });
+
+    const size_t document_count = read_count();
+    //   :         
+    vector<uint64_t> word_counts;
+    word_counts.reserve(document_count);
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        const int document_id = ReadValue<int32_t>(in);
+        const int32_t status = ReadValue<int32_t>(in);
+        const int rating = ReadValue<int32_t>(in);
+        const uint64_t word_count = ReadValue<uint64_t>(in);
+        if (document_id < 0 || status < 0 || status >= static_cast<int32_t>(DOCUMENT_STATUS_COUNT) || word_count > file_size) {
+            throw damaged();
+        }
+        const string text = ReadString(in, file_size);
+        //         
+        vector<TermId> term_ids;
+        for (size_t pair_count = read_count(); pair_count > 0; --pair_count) {
+            const TermId term_id = ReadValue<TermId>(in);
+            const uint32_t occurrences = ReadValue<uint32_t>(in);
+            //      ,     ,  
+            if (term_id >= term_count || (!term_ids.empty() && term_id <= term_ids.back())
+                || occurrences > word_count - term_ids.size()) {
+                throw damaged();
+            }
+            term_ids.insert(term_ids.end(), occurrences, term_id);
+        }
+        if (term_ids.size() != word_count) {
+            throw damaged();
+        }
+        if (!server.document_to_ordinal_.emplace(document_id, static_cast<int>(ordinal)).second) {
+            throw damaged();
+        }
+        const double inv_word_count = 1.0 / word_count;
+        server.documents_.Add(document_id, rating, static_cast<DocumentStatus>(status), inv_word_count, text);
+        server.forward_index_.Add(move(term_ids), inv_word_count);
+        server.document_ids_.insert(document_id);
+        word_counts.push_back(word_count);
+    }
+
+    const auto& word_weights = server.documents_.GetWordWeights();
+    server.VisitPostings([&](auto& index) {
+        IndexFileOccurrence previous{ 0, 0, 0 };
+        for (uint64_t occurrence_count = read_count(); occurrence_count > 0; --occurrence_count) {
+            const auto occurrence = ReadValue<IndexFileOccurrence>(in);
+            //        
+            const bool ascending = previous.count == 0 || occurrence.term_id > previous.term_id
+                || (occurrence.term_id == previous.term_id && occurrence.ordinal > previous.ordinal);
+            if (occurrence.term_id >= term_count || occurrence.ordinal >= document_count || occurrence.count == 0
+                || occurrence.count > word_counts[occurrence.ordinal] || !ascending) {
+                throw damaged();
+            }
+            for (uint32_t i = 0; i < occurrence.count; ++i) {
+                index[occurrence.term_id].Add(occurrence.ordinal, word_weights[occurrence.ordinal]);
+            }
+            previous = occurrence;
+        }
+        });
+    server.UpdateLogDocumentCount();
+    ++server.index_version_;
+    return server;
+}
+
+void SearchServer::SaveSnapshot(const string& path) const {
+    using namespace std;
+    ofstream out(path, ios::binary);
+    if (!out) {
+        throw runtime_error("Cannot create "s + path);
+    }
+    SnapshotWriter writer(out);
+    SnapshotRoot root{};
+    root.posting_layout = static_cast<uint32_t>(posting_layout_);
+    root.stop_words = writer.WriteStrings(*stop_words_);
+    root.terms = terms_.Save(writer);
+    root.postings = VisitPostings([&writer](const auto& index) {
+        using Postings = typename decay_t<decltype(index)>::value_type;
+        vector<typename Postings::SnapshotEntry> entries;
+        entries.reserve(index.size());
+        for (const Postings& postings : index) {
+            entries.push_back(postings.Save(writer));
+        }
+        return writer.Write(entries);
+        });
+    root.removed_terms = writer.Write(removed_terms_);
+    root.documents = documents_.Save(writer);
+    root.forward_index = forward_index_.Save(writer);
+    vector<int> document_ids;
+    vector<int> document_ordinals;
+    document_ids.reserve(document_to_ordinal_.size());
+    document_ordinals.reserve(document_to_ordinal_.size());
+    for (const auto& [document_id, ordinal] : document_to_ordinal_) {
+        document_ids.push_back(document_id);
+        document_ordinals.push_back(ordinal);
+    }
+    root.document_ids = writer.Write(document_ids);
+    root.document_ordinals = writer.Write(document_ordinals);
+    writer.Finish(writer.WriteValue(root));
+}
+
+SearchServer SearchServer::OpenSnapshot(const string& path, DocumentTextStorage text_storage) {
+    using namespace std;
+    const auto file = make_shared<const MappedFile>(path);
+    const SnapshotReader reader(file);
+    const SnapshotRoot& root = reader.Value<SnapshotRoot>(reader.Root());
+    if (root.posting_layout > static_cast<uint32_t>(PostingLayout::COMPRESSED)) {
+        throw runtime_error("Snapshot file is damaged"s);
+    }
+    SearchServer server(reader.Strings(root.stop_words), static_cast<PostingLayout>(root.posting_layout), text_storage);
+    server.snapshot_file_ = file;
+    server.terms_.Load(reader, root.terms);
+    const size_t term_count = server.terms_.size();
+    server.documents_.Load(reader, root.documents);
+    const size_t ordinal_count = server.documents_.size();
+    server.forward_index_.Load(reader, root.forward_index, ordinal_count, term_count);
+    server.VisitPostings([&](auto& index) {
+        using Postings = typename decay_t<decltype(index)>::value_type;
+        const auto entries = reader.Array<typename Postings::SnapshotEntry>(root.postings);
+        if (entries.size() != term_count) {
+            throw runtime_error("Snapshot file is damaged"s);
+        }
+        index.resize(entries.size());
+        for (size_t term_id = 0; term_id < entries.size(); ++term_id) {
+            index[term_id].Load(reader, entries[term_id], ordinal_count);
+        }
+        });
+    server.checked_postings_.reset(new atomic<bool>[term_count]());
+    server.snapshot_term_count_ = term_count;
+    const auto removed_terms = reader.Array<TermId>(root.removed_terms);
+    if (any_of(removed_terms.begin(), removed_terms.end(), [term_count](TermId term_id) { return term_id >= term_count; })) {
+        throw runtime_error("Snapshot file is damaged"s);
+    }
+    server.removed_terms_.assign(removed_terms.begin(), removed_terms.end());
+
+    //       id: id ,        id
+    const auto document_ids = reader.Array<int>(root.document_ids);
+    const auto document_ordinals = reader.Array<int>(root.document_ordinals);
+    if (document_ordinals.size() != document_ids.size()
+        || document_ids.size() != ordinal_count - server.documents_.RemovedCount()) {
+        throw runtime_error("Snapshot file is damaged"s);
+    }
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const int ordinal = document_ordinals[i];
+        if (document_ids[i] < 0 || (i > 0 && document_ids[i] <= document_ids[i - 1])
+            || ordinal < 0 || static_cast<size_t>(ordinal) >= ordinal_count
+            || server.documents_.IsRemoved(ordinal) || server.documents_.GetId(ordinal) != document_ids[i]) {
+            throw runtime_error("Snapshot file is damaged"s);
+        }
+    }
+    // id   ,        
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        server.document_to_ordinal_.emplace_hint(server.document_to_ordinal_.end(), document_ids[i], document_ordinals[i]);
+        server.document_ids_.insert(server.document_ids_.end(), document_ids[i]);
+    }
+    server.UpdateLogDocumentCount();
+    ++server.index_version_;
+    return server;
+}
+
 size_t SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_to_ordinal_.size();
 }
 std::set<int>::const_iterator  SearchServer::begin() const {
     return document_ids_.begin();
@@ -53,35 +377,35 @@ tuple< vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_v
     if (raw_query.empty()) {
         throw std::invalid_argument("incorrect value");
     }
-    if (document_ids_.count(document_id) == 0) {
+    const auto ordinal_it = document_to_ordinal_.find(document_id);
+    if (ordinal_it == document_to_ordinal_.end()) {
         throw std::out_of_range("incorrect id");
     }
-
-    const auto query = ParseQuery(raw_query, true);
-    vector<string_view> matched_words;
-
-    for (string_view word : query.minus_words) {
-        //         
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        //           
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            //matched_words.clear();
-            return { matched_words, documents_.at(document_id).status };
-        }
+    const int ordinal = ordinal_it->second;
+
+    auto query = ParseQuery(raw_query, true);
+    //     ,      
+    const auto document_terms = forward_index_.Get(ordinal);
+    vector<TermId> matched_terms(max(query.plus_words.size(), query.minus_words.size()));
+
+    std::sort(query.minus_words.begin(), query.minus_words.end());
+    //        
+    if (IntersectSorted(query.minus_words.data(), query.minus_words.size(),
+        document_terms.term_ids, document_terms.size, matched_terms.data()) > 0) {
+        return { vector<string_view>{}, documents_.GetStatus(ordinal) };
     }
 
-    for (const string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
-        }
+    matched_terms.resize(IntersectSorted(query.plus_words.data(), query.plus_words.size(),
+        document_terms.term_ids, document_terms.size, matched_terms.data()));
+    vector<string_view> matched_words;
+    matched_words.reserve(matched_terms.size());
+    for (const TermId term_id : matched_terms) {
+        matched_words.push_back(terms_.GetTerm(term_id));
     }
+    //      ,    
+    std::sort(matched_words.begin(), matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, documents_.GetStatus(ordinal) };
 }
 
 //    
@@ -96,33 +420,35 @@ tuple< std::vector<string_view>, DocumentStatus> SearchServer::MatchDocument(con
     if (raw_query.empty()) {
         throw std::invalid_argument("incorrect value");
     }
-    if (document_ids_.count(document_id) <= 0) {
+    const auto ordinal_it = document_to_ordinal_.find(document_id);
+    if (ordinal_it == document_to_ordinal_.end()) {
         throw std::out_of_range("incorrect id");
     }
+    const int ordinal = ordinal_it->second;
     const auto query = ParseQuery(raw_query, false);
 
-    if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&](auto word) {
-        return word_to_document_freqs_.count(word) &&
-            word_to_document_freqs_.at(word).count(document_id); })) {
-        return { vector<string_view>{}, documents_.at(document_id).status };
+    const auto contains_document = [this, ordinal](TermId term_id) {
+        return VisitPostings([term_id, ordinal](const auto& index) {
+            return index[term_id].Contains(ordinal);
+            });
+    };
+    if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), contains_document)) {
+        return { vector<string_view>{}, documents_.GetStatus(ordinal) };
     }
-    vector<string_view> matched_words(query.plus_words.size());
-    auto end_words = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](auto word) {
-        return word_to_document_freqs_.count(word) &&
-            word_to_document_freqs_.at(word).count(document_id);
-        });
+    vector<TermId> matched_terms(query.plus_words.size());
+    auto end_terms = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_terms.begin(), contains_document);
     //     
-    matched_words.resize(std::distance(matched_words.begin(), end_words));
+    matched_terms.resize(std::distance(matched_terms.begin(), end_terms));
+    vector<string_view> matched_words(matched_terms.size());
+    std::transform(matched_terms.begin(), matched_terms.end(), matched_words.begin(), [this](TermId term_id) {
+        return terms_.GetTerm(term_id);
+        });
     std::sort(matched_words.begin(), matched_words.end());
 
     auto last = std::unique(matched_words.begin(), matched_words.end());
     matched_words.erase(last, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
-}
-
-bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count(word) > 0;
+    return { matched_words, documents_.GetStatus(ordinal) };
 }
 
 bool SearchServer::IsValidWord(string_view word) {
@@ -133,13 +459,17 @@ bool SearchServer::IsValidWord(string_view word) {
 }
 
 vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
+    return SplitIntoWordsNoStop(text, *stop_words_);
+}
+
+vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text, const set<string, less<>>& stop_words) {
     using namespace std;
     vector<string_view> words;
     for (auto& word : SplitIntoWords(text)) {
         if (!IsValidWord(word)) {
             throw invalid_argument("Word "s + string(word) + " is invalid"s);
         }
-        if (!IsStopWord(word)) {
+        if (stop_words.count(word) == 0) {
             words.push_back(word);
         }
     }
@@ -154,6 +484,10 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 }
 
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+    return ParseQueryWord(text, *stop_words_);
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text, const set<string, less<>>& stop_words) {
     using namespace std;
     if (text.empty()) {
         throw invalid_argument("Query word is empty"s);
@@ -167,43 +501,77 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
     if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
         throw invalid_argument("Query word "s + string(word) + " is invalid");
     }
-    return { word, is_minus, IsStopWord(word) };
+    return { word, is_minus, stop_words.count(word) > 0 };
+}
+
+void SearchServer::CheckPostings(TermId term_id) const {
+    //       :   
+    if (term_id >= snapshot_term_count_ || checked_postings_[term_id].load(memory_order_acquire)) {
+        return;
+    }
+    VisitPostings([this, term_id](const auto& index) {
+        CheckPostingList(index[term_id]);
+        });
+    checked_postings_[term_id].store(true, memory_order_release);
+}
+
+void SearchServer::CheckAllPostings() const {
+    for (TermId term_id = 0; term_id < snapshot_term_count_; ++term_id) {
+        CheckPostings(term_id);
+    }
 }
 
 SearchServer::Query SearchServer::ParseQuery(string_view text, bool use_sort) const {
     Query result;
     for (auto& word : SplitIntoWords(text)) {
         const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            }
-            else {
-                result.plus_words.push_back(query_word.data);
-            }
+        if (query_word.is_stop) {
+            continue;
+        }
+        //,    ,      
+        const TermId term_id = terms_.Find(query_word.data);
+        if (term_id == TermDictionary::NO_TERM) {
+            continue;
+        }
+        CheckPostings(term_id);
+        if (query_word.is_minus) {
+            result.minus_words.push_back(term_id);
+        }
+        else {
+            result.plus_words.push_back(term_id);
         }
     }
     //            
     if (use_sort) {
-        std::sort(result.plus_words.begin(), result.plus_words.end(), [](const auto& lhs, const auto& rhs) { return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
-            });
+        std::sort(result.plus_words.begin(), result.plus_words.end());
         auto last = std::unique(result.plus_words.begin(), result.plus_words.end());
         result.plus_words.erase(last, result.plus_words.end());
     }
+    result.inverse_document_freqs.reserve(result.plus_words.size());
+    for (const TermId term_id : result.plus_words) {
+        result.inverse_document_freqs.push_back(ComputeWordInverseDocumentFreq(term_id));
+    }
     return result;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const {
+    return log_document_count_ - VisitPostings([term_id](const auto& index) {
+        return index[term_id].LogDocumentFreq();
+        });
+}
+
+void SearchServer::UpdateLogDocumentCount() {
+    log_document_count_ = log(static_cast<double>(GetDocumentCount()));
 }
 
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
-        raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+    return FindTopDocuments(raw_query, status, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+    size_t count, size_t offset, RetrievalMode mode) const {
+    return FindTopDocumentsByFilter(raw_query, MakeStatusFilter(status), count, offset, mode);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
@@ -211,23 +579,43 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query)
 }
 
 //============================ new method ================================
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    assert(word_freq_.count(document_id) != 0);
-    return { word_freq_.at(document_id) };
+//     ,     
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    assert(document_to_ordinal_.count(document_id) != 0);
+    const auto document_terms = forward_index_.Get(document_to_ordinal_.at(document_id));
+    std::map<std::string_view, double> result;
+    for (size_t i = 0; i < document_terms.size; ++i) {
+        result.emplace(terms_.GetTerm(document_terms.term_ids[i]), document_terms.term_freqs[i]);
+    }
+    return result;
 }
 
-//     
-void SearchServer::RemoveDocument(int document_id) {
-    if (!document_ids_.count(document_id)) { return; }
-    word_freq_.erase(document_id);
-    documents_.erase(document_id);
+string_view SearchServer::GetDocumentText(int document_id) const {
+    const auto ordinal_it = document_to_ordinal_.find(document_id);
+    if (ordinal_it == document_to_ordinal_.end()) {
+        throw std::out_of_range("incorrect id");
+    }
+    return documents_.GetText(ordinal_it->second);
+}
 
-    for (auto& element : word_to_document_freqs_) {
-        if (element.second.count(document_id)) {
-            element.second.erase(document_id);
+//     .       Compact,
+//       ,     
+void SearchServer::RemoveDocument(int document_id) {
+    const auto ordinal_it = document_to_ordinal_.find(document_id);
+    if (ordinal_it == document_to_ordinal_.end()) { return; }
+    const int ordinal = ordinal_it->second;
+    const auto document_terms = forward_index_.Get(ordinal);
+    VisitPostings([this, &document_terms](auto& index) {
+        for (size_t i = 0; i < document_terms.size; ++i) {
+            index[document_terms.term_ids[i]].MarkRemoved();
         }
-    }
+        });
+    removed_terms_.insert(removed_terms_.end(), document_terms.term_ids, document_terms.term_ids + document_terms.size);
+    documents_.Remove(ordinal);
+    document_to_ordinal_.erase(ordinal_it);
+    UpdateLogDocumentCount();
     document_ids_.erase(document_id);
+    ++index_version_;
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy& policy, int document_id) {
@@ -236,23 +624,91 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy& policy
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy& policy, int document_id) {
     //       id 
-    if (!document_ids_.count(document_id)) { return; }
-    //        
-    std::vector<std::string_view> keywords_for_remove(word_freq_.at(document_id).size());
-
-    std::transform(std::execution::par, word_freq_.at(document_id).begin(), word_freq_.at(document_id).end(), keywords_for_remove.begin(), [&keywords_for_remove, &document_id](auto document) {
-        return document.first;
-        });
-
-    //         id 
-    std::for_each(std::execution::par, keywords_for_remove.begin(), keywords_for_remove.end(), [this, &document_id](auto word) {
-        this->word_to_document_freqs_.at(word).erase(document_id);
+    const auto ordinal_it = document_to_ordinal_.find(document_id);
+    if (ordinal_it == document_to_ordinal_.end()) { return; }
+    const int ordinal = ordinal_it->second;
+    //         
+    const auto document_terms = forward_index_.Get(ordinal);
+    const TermId* keywords_begin = document_terms.term_ids;
+    const TermId* keywords_end = document_terms.term_ids + document_terms.size;
+
+    //   ,     
+    VisitPostings([keywords_begin, keywords_end](auto& index) {
+        std::for_each(std::execution::par, keywords_begin, keywords_end, [&index](TermId term_id) {
+            index[term_id].MarkRemoved();
+            });
         });
+    removed_terms_.insert(removed_terms_.end(), keywords_begin, keywords_end);
 
     //    id    id 
+    documents_.Remove(ordinal);
     document_ids_.erase(document_id);
-    word_freq_.erase(document_id);
-    documents_.erase(document_id);
+    document_to_ordinal_.erase(ordinal_it);
+    UpdateLogDocumentCount();
+    ++index_version_;
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocumentBatch(std::execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::sequenced_policy& policy, const vector<int>& document_ids) {
+    RemoveDocumentBatch(policy, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::parallel_policy& policy, const vector<int>& document_ids) {
+    RemoveDocumentBatch(policy, document_ids);
+}
+
+void SearchServer::Compact() {
+    CompactPostings(std::execution::seq);
+}
+
+void SearchServer::Compact(const std::execution::sequenced_policy& policy) {
+    CompactPostings(policy);
+}
+
+void SearchServer::Compact(const std::execution::parallel_policy& policy) {
+    CompactPostings(policy);
+}
+
+void SearchServer::BuildImpactIndex() {
+    CheckAllPostings();
+    VisitPostings([this](const auto& index) {
+        //           
+        double max_impact = 0.0;
+        for (TermId term_id = 0; term_id < index.size(); ++term_id) {
+            if (index[term_id].DocumentFreq() > 0) {
+                max_impact = max(max_impact, index[term_id].MaxTermFreq() * ComputeWordInverseDocumentFreq(term_id));
+            }
+        }
+        impact_index_.Reset(index.size(), max_impact, index_version_);
+        const int document_count = static_cast<int>(documents_.size());
+        for (TermId term_id = 0; term_id < index.size(); ++term_id) {
+            if (index[term_id].DocumentFreq() == 0) {
+                continue;
+            }
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+            impact_index_.Reserve(term_id, index[term_id].size());
+            for (auto cursor = MakeCursor(index[term_id], 0, document_count); !cursor.AtEnd(); cursor.NextChunk()) {
+                for (size_t i = 0; i < cursor.ChunkSize(); ++i) {
+                    impact_index_.Add(term_id, cursor.ChunkOrdinals()[i], cursor.ChunkTermFreq(i) * inverse_document_freq);
+                }
+            }
+        }
+        });
+}
+
+ImpactDeviation SearchServer::CompareImpactRanking(string_view raw_query, size_t count) const {
+    if (!impact_index_.IsCurrent(index_version_)) {
+        throw logic_error("Impact index is out of date"s);
+    }
+    const auto query = ParseQuery(raw_query);
+    auto status_filter = MakeStatusFilter(DocumentStatus::ACTUAL);
+    TopDocuments top_documents(count);
+    ImpactDeviation deviation;
+    CollectByImpact(query, status_filter, 0, static_cast<int>(documents_.size()), top_documents, &deviation);
+    return deviation;
 }
 
 
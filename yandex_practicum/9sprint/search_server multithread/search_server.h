@@ -4,9 +4,10 @@
 #include <cassert>
 #include <string>
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <set>
-#include <deque>
+#include <limits>
 #include <map>
 #include <stdexcept>
 #include "document.h"
@@ -15,26 +16,99 @@
 #include <type_traits>
 #include <thread>
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "posting_list.h"
+#include "compressed_posting_list.h"
+#include "term_dictionary.h"
+#include "document_attributes.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+#include "posting_kernels.h"
+#include "impact_index.h"
+#include "forward_index.h"
+#include "snapshot_file.h"
+#include <memory>
+#include <atomic>
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+//    ,     
+enum class RetrievalMode {
+    EXHAUSTIVE, //     
+    MAX_SCORE,  //        ,          
+    BLOCK_MAX,  //  ,       ,     
+    IMPACT,     //       BuildImpactIndex,   ;
+                //     BuildImpactIndex,   
+};
+
+//   :  ,       
+enum class PostingLayout {
+    PLAIN,
+    COMPRESSED,
+};
+
+//     .     :    ,
+//          
+enum class DocumentTextStorage {
+    DISCARD,
+    KEEP,
+};
+
+//      AddDocuments
+struct NewDocument {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+//   SegmentedSearchServer, . memtable.h
+class MemTable;
+
 class SearchServer {
 public:
 
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string& stop_words_text);
-    explicit SearchServer(std::string_view stop_words_text);
+    explicit SearchServer(const StringContainer& stop_words, PostingLayout posting_layout = PostingLayout::PLAIN,
+        DocumentTextStorage text_storage = DocumentTextStorage::DISCARD);
+    explicit SearchServer(const std::string& stop_words_text, PostingLayout posting_layout = PostingLayout::PLAIN,
+        DocumentTextStorage text_storage = DocumentTextStorage::DISCARD);
+    explicit SearchServer(std::string_view stop_words_text, PostingLayout posting_layout = PostingLayout::PLAIN,
+        DocumentTextStorage text_storage = DocumentTextStorage::DISCARD);
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    //       ,   AddDocument  .  
+    //  ,       ,    .
+    //   :        
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+    //    ,  ExternalIndexBuilder, -   .
+    //      ,      ,     
+    static SearchServer LoadIndex(const std::string& path, PostingLayout posting_layout = PostingLayout::PLAIN,
+        DocumentTextStorage text_storage = DocumentTextStorage::DISCARD);
+    //   : -, ,  ,     
+    void SaveSnapshot(const std::string& path) const;
+    //    mmap.  ,       
+    //        ,    ;    
+    // - ,  id    .     .
+    //    runtime_error: , ,      
+    //  ,    -      ,       runtime_error
+    static SearchServer OpenSnapshot(const std::string& path, DocumentTextStorage text_storage = DocumentTextStorage::DISCARD);
 
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    //  :  offset       count ,
+    //       offset + count 
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t count, size_t offset = 0,
+        RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t count, size_t offset = 0,
+        RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+
 
     //    
     template<typename ExecutionPolicy>
@@ -43,6 +117,12 @@ public:
     std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status) const;
     template <typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template<typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status, size_t count, size_t offset = 0,
+        RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t count, size_t offset = 0,
+        RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
 
     //============================ new method ================================
     size_t GetDocumentCount() const;
@@ -51,20 +131,43 @@ public:
     std::set<int>::iterator begin();
     std::set<int>::iterator end();
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+    //   ,     DocumentTextStorage::KEEP,   
+    std::string_view GetDocumentText(int document_id) const;
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+    //   :     ,   
+    //     ;      
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::sequenced_policy&, const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids);
+    // RemoveDocument    ,      ;
+    //        .      ,
+    //     ,  ,   .
+    // string_view  GetWordFrequencies  MatchDocument     
+    void Compact();
+    void Compact(const std::execution::sequenced_policy&);
+    void Compact(const std::execution::parallel_policy&);
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
 
+    //      RetrievalMode::IMPACT    
+    void BuildImpactIndex();
+    //            ACTUAL,
+    //  logic_error,    
+    ImpactDeviation CompareImpactRanking(std::string_view raw_query, size_t count = MAX_RESULT_DOCUMENT_COUNT) const;
+
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
+    //       ,         
+    friend class ExternalIndexBuilder;
+    friend class DurableSearchServer;
+    //      AppendDocuments   IDF   
+    friend class SegmentedSearchServer;
+    //       
+    friend class MemTable;
 
     struct QueryWord {
         std::string_view data;
@@ -72,153 +175,792 @@ private:
         bool is_stop;
     };
 
-    std::deque<std::string> document_text_; //    
-    const std::set<std::string, std::less<>> stop_words_; //    
+    //    ;  SegmentedSearchServer   
+    const std::shared_ptr<const std::set<std::string, std::less<>>> stop_words_;
 
-    //    
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> word_freq_;
+    //       
+    TermDictionary terms_;
+    //  -  ;     
+    const PostingLayout posting_layout_;
+    std::vector<PostingList> word_to_document_freqs_;
+    std::vector<CompressedPostingList> compressed_document_freqs_;
+    //   ,      Compact
+    std::vector<TermId> removed_terms_;
 
 
-    std::map<int, DocumentData> documents_;
+    //       ,
+    //  id         
+    DocumentAttributes documents_;
+    //        
+    ForwardIndex forward_index_;
+    std::map<int, int> document_to_ordinal_;
     std::set<int> document_ids_;
+    // IDF = log(N / df) = log(N) - log(df): log(df)     ,
+    // log(N)     ,      
+    double log_document_count_ = 0.0;
+    //       ,      
+    uint64_t index_version_ = 0;
+    ImpactIndex impact_index_;
+    //  ,      
+    std::shared_ptr<const MappedFile> snapshot_file_;
+    //          ,   
+    //    ,      .  -    
+    std::shared_ptr<std::atomic<bool>[]> checked_postings_;
+    size_t snapshot_term_count_ = 0;
+
+    //      -  
+    SearchServer(std::shared_ptr<const std::set<std::string, std::less<>>> stop_words, PostingLayout posting_layout,
+        DocumentTextStorage text_storage);
+
+    template <typename ExecutionPolicy>
+    void AddDocumentBatch(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents);
+    // ,  id     ,       -,
+    //    - .     SearchServer  SegmentedSearchServer
+    template <typename ExecutionPolicy>
+    static std::vector<std::vector<std::string_view>> SplitDocuments(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents,
+        const std::set<std::string, std::less<>>& stop_words);
+    //      source,    excluded,    ,  
+    // .     ,         
+    void AppendDocuments(const SearchServer& source, const Bitmap& excluded);
+    //     ordinal_count   
+    void AppendDocuments(const MemTable& source, size_t ordinal_count, const Bitmap& excluded);
+    //      ;  term_ids     
+    void AppendDocument(int document_id, int rating, DocumentStatus status, double word_weight, std::string_view text,
+        const std::vector<TermId>& term_ids);
+    template <typename ExecutionPolicy>
+    void RemoveDocumentBatch(const ExecutionPolicy& policy, const std::vector<int>& document_ids);
+    template <typename ExecutionPolicy>
+    void CompactPostings(const ExecutionPolicy& policy);
+    //      ,       
+    template <typename ExecutionPolicy>
+    void RenumberDocuments(const ExecutionPolicy& policy);
 
-    bool IsStopWord(std::string_view word) const;
     static bool IsValidWord(std::string_view word);
     static int ComputeAverageRating(const std::vector<int>& ratings);
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    //      SearchServer  ExternalIndexBuilder
+    static std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text, const std::set<std::string, std::less<>>& stop_words);
 
     QueryWord ParseQueryWord(std::string_view text) const;
+    static QueryWord ParseQueryWord(std::string_view text, const std::set<std::string, std::less<>>& stop_words);
+    //     ,    
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
+        // IDF -    ;     IDF   
+        std::vector<double> inverse_document_freqs;
     };
 
     Query ParseQuery(std::string_view text, bool use_sort = true) const;
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
+    void UpdateLogDocumentCount();
 
+    //     :        
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query,
-        DocumentPredicate document_predicate) const;
+    auto MakeOrdinalFilter(DocumentPredicate document_predicate) const;
+    auto MakeStatusFilter(DocumentStatus status) const;
+
+    template <typename OrdinalFilter>
+    std::vector<Document> FindTopDocumentsByFilter(std::string_view raw_query, OrdinalFilter ordinal_filter,
+        size_t count, size_t offset, RetrievalMode mode) const;
+    template <typename OrdinalFilter, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsByFilter(const ExecutionPolicy policy, std::string_view raw_query, OrdinalFilter ordinal_filter,
+        size_t count, size_t offset, RetrievalMode mode) const;
+
+    //  action       
+    template <typename Action>
+    decltype(auto) VisitPostings(Action action) const;
+    template <typename Action>
+    decltype(auto) VisitPostings(Action action);
+    PostingList::Cursor MakeCursor(const PostingList& postings, int first_ordinal, int last_ordinal) const {
+        return PostingList::Cursor(postings, first_ordinal, last_ordinal);
+    }
+    CompressedPostingList::Cursor MakeCursor(const CompressedPostingList& postings, int first_ordinal, int last_ordinal) const {
+        return CompressedPostingList::Cursor(postings, documents_.GetWordWeights(), first_ordinal, last_ordinal);
+    }
+    void CheckPostingList(const PostingList& postings) const {
+        postings.Check();
+    }
+    void CheckPostingList(const CompressedPostingList& postings) const {
+        postings.Check(documents_.GetWordWeights());
+    }
+    //     ,      ;  runtime_error,   
+    void CheckPostings(TermId term_id) const;
+    void CheckAllPostings() const;
+    ImpactPostingList::Cursor MakeCursor(const ImpactPostingList& postings, int first_ordinal, int last_ordinal) const {
+        return ImpactPostingList::Cursor(postings, first_ordinal, last_ordinal);
+    }
+
+    //      [first_ordinal, last_ordinal)  -   :
+    //  double -  ,    -     
+    template <typename Score, typename Postings, typename OrdinalFilter>
+    const ScoreAccumulator<Score>& AccumulateScores(const std::vector<Postings>& index, const Query& query, OrdinalFilter& ordinal_filter,
+        int first_ordinal, int last_ordinal) const;
+
+    //      [first_ordinal, last_ordinal)     top_documents
+    template <typename Postings, typename OrdinalFilter>
+    void AccumulateRelevance(const std::vector<Postings>& index, const Query& query, OrdinalFilter& ordinal_filter,
+        int first_ordinal, int last_ordinal, TopDocuments& top_documents) const;
+    //     MaxScore:     ,
+    //         ,      .
+    //  use_block_max      
+    template <typename Postings, typename OrdinalFilter>
+    void CollectByMaxScore(const std::vector<Postings>& index, const Query& query, OrdinalFilter& ordinal_filter,
+        int first_ordinal, int last_ordinal, bool use_block_max, TopDocuments& top_documents) const;
+    //           ,
+    //  deviation    
+    template <typename OrdinalFilter>
+    void CollectByImpact(const Query& query, OrdinalFilter& ordinal_filter,
+        int first_ordinal, int last_ordinal, TopDocuments& top_documents, ImpactDeviation* deviation = nullptr) const;
+    //   top_documents     [first_ordinal, last_ordinal)  
+    template <typename OrdinalFilter>
+    void CollectTopDocuments(const Query& query, OrdinalFilter& ordinal_filter,
+        int first_ordinal, int last_ordinal, RetrievalMode mode, TopDocuments& top_documents) const;
+
+    //  top_count    
+    template <typename OrdinalFilter>
+    TopDocuments FindAllDocuments(const Query& query,
+        OrdinalFilter ordinal_filter, size_t top_count, RetrievalMode mode) const;
 
     //   
-    template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindAllDocuments(const ExecutionPolicy policy, const Query& query,
-        DocumentPredicate document_predicate) const;
+    template <typename OrdinalFilter, typename ExecutionPolicy>
+    TopDocuments FindAllDocuments(const ExecutionPolicy policy, const Query& query,
+        OrdinalFilter ordinal_filter, size_t top_count, RetrievalMode mode) const;
 };
 
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
+SearchServer::SearchServer(const StringContainer& stop_words, PostingLayout posting_layout, DocumentTextStorage text_storage)
+    : SearchServer(std::make_shared<const std::set<std::string, std::less<>>>(MakeUniqueNonEmptyStrings(stop_words)),
+        posting_layout, text_storage) {
     using namespace std;
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+    if (!all_of(stop_words_->begin(), stop_words_->end(), IsValidWord)) {
         throw invalid_argument("Some of stop words are invalid"s);
     }
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
+auto SearchServer::MakeOrdinalFilter(DocumentPredicate document_predicate) const {
+    return [this, document_predicate](int ordinal) {
+        return !documents_.IsRemoved(ordinal) && document_predicate(documents_.GetId(ordinal), documents_.GetStatus(ordinal), documents_.GetRating(ordinal));
+    };
+}
+
+//      ,      ;     
+inline auto SearchServer::MakeStatusFilter(DocumentStatus status) const {
+    return [&status_bitmap = documents_.GetStatusBitmap(status)](int ordinal) {
+        return status_bitmap.Test(ordinal);
+    };
+}
+
+template <typename Action>
+decltype(auto) SearchServer::VisitPostings(Action action) const {
+    if (posting_layout_ == PostingLayout::COMPRESSED) {
+        return action(compressed_document_freqs_);
+    }
+    return action(word_to_document_freqs_);
+}
+
+template <typename Action>
+decltype(auto) SearchServer::VisitPostings(Action action) {
+    if (posting_layout_ == PostingLayout::COMPRESSED) {
+        return action(compressed_document_freqs_);
+    }
+    return action(word_to_document_freqs_);
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::vector<std::string_view>> SearchServer::SplitDocuments(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents,
+    const std::set<std::string, std::less<>>& stop_words) {
+    using namespace std;
+    vector<int> batch_ids(documents.size());
+    transform(documents.begin(), documents.end(), batch_ids.begin(), [](const NewDocument& document) {
+        return document.id;
+        });
+    sort(policy, batch_ids.begin(), batch_ids.end());
+    if (adjacent_find(batch_ids.begin(), batch_ids.end()) != batch_ids.end()
+        || any_of(batch_ids.begin(), batch_ids.end(), [](int id) { return id < 0; })) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    //      ,       
+    vector<size_t> document_indexes(documents.size());
+    iota(document_indexes.begin(), document_indexes.end(), 0);
+    vector<vector<string_view>> document_words(documents.size());
+    vector<exception_ptr> errors(documents.size());
+    for_each(policy, document_indexes.begin(), document_indexes.end(), [&](size_t i) {
+        try {
+            document_words[i] = SplitIntoWordsNoStop(documents[i].text, stop_words);
+        }
+        catch (...) {
+            errors[i] = current_exception();
+        }
+        });
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+    return document_words;
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentBatch(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents) {
+    using namespace std;
+    //      
+    if (any_of(documents.begin(), documents.end(), [this](const NewDocument& document) {
+        return document_to_ordinal_.count(document.id) > 0;
+        })) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    const vector<vector<string_view>> document_words = SplitDocuments(policy, documents, *stop_words_);
+
+    //       ,      ,     
+    const int first_ordinal = static_cast<int>(documents_.size());
+    vector<vector<TermId>> document_terms(documents.size());
+    size_t occurrence_count = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        document_terms[i].reserve(document_words[i].size());
+        for (const string_view word : document_words[i]) {
+            document_terms[i].push_back(terms_.Intern(word));
+        }
+        occurrence_count += document_terms[i].size();
+        const double inv_word_count = 1.0 / document_words[i].size();
+        documents_.Add(documents[i].id, ComputeAverageRating(documents[i].ratings), documents[i].status, inv_word_count, documents[i].text);
+    }
+
+    //      
+    for_each(policy, document_terms.begin(), document_terms.end(), [](vector<TermId>& term_ids) {
+        sort(term_ids.begin(), term_ids.end());
+        });
 
-    auto matched_documents = FindAllDocuments(query, document_predicate);
-    constexpr double EPSILON = 1e-6;
-    sort(matched_documents.begin(), matched_documents.end(),
-        [EPSILON](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
+    //     :        ,
+    //     ,      
+    vector<size_t> term_starts(terms_.size() + 1, 0);
+    for (const auto& term_ids : document_terms) {
+        for (const TermId term_id : term_ids) {
+            ++term_starts[term_id + 1];
+        }
+    }
+    partial_sum(term_starts.begin(), term_starts.end(), term_starts.begin());
+    vector<int> occurrence_ordinals(occurrence_count);
+    vector<size_t> positions(term_starts.begin(), prev(term_starts.end()));
+    vector<TermId> touched_terms;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        for (const TermId term_id : document_terms[i]) {
+            if (positions[term_id] == term_starts[term_id]) {
+                touched_terms.push_back(term_id);
             }
-            else {
-                return lhs.relevance > rhs.relevance;
+            occurrence_ordinals[positions[term_id]++] = first_ordinal + static_cast<int>(i);
+        }
+    }
+    //      
+    const auto& word_weights = documents_.GetWordWeights();
+    VisitPostings([&](auto& index) {
+        if (index.size() < terms_.size()) {
+            index.resize(terms_.size());
+        }
+        for_each(policy, touched_terms.begin(), touched_terms.end(), [&](TermId term_id) {
+            for (size_t k = term_starts[term_id]; k < term_starts[term_id + 1]; ++k) {
+                index[term_id].Add(occurrence_ordinals[k], word_weights[occurrence_ordinals[k]]);
             }
+            });
         });
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        forward_index_.Add(move(document_terms[i]), word_weights[first_ordinal + i]);
+        //      id,       
+        document_to_ordinal_.emplace_hint(document_to_ordinal_.end(), documents[i].id, first_ordinal + static_cast<int>(i));
+        document_ids_.insert(document_ids_.end(), documents[i].id);
     }
-    return matched_documents;
+    UpdateLogDocumentCount();
+    ++index_version_;
 }
 
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocumentBatch(const ExecutionPolicy& policy, const std::vector<int>& document_ids) {
+    using namespace std;
+    //   ,       removed_terms_
+    const size_t first_term = removed_terms_.size();
+    const size_t document_count = GetDocumentCount();
+    for (const int document_id : document_ids) {
+        const auto ordinal_it = document_to_ordinal_.find(document_id);
+        if (ordinal_it == document_to_ordinal_.end()) {
+            continue;
+        }
+        const auto document_terms = forward_index_.Get(ordinal_it->second);
+        removed_terms_.insert(removed_terms_.end(), document_terms.term_ids, document_terms.term_ids + document_terms.size);
+        documents_.Remove(ordinal_it->second);
+        document_to_ordinal_.erase(ordinal_it);
+        document_ids_.erase(document_id);
+    }
+    if (document_count == GetDocumentCount()) {
+        return;
+    }
+    UpdateLogDocumentCount();
+    ++index_version_;
+    //        
+    if (first_term == removed_terms_.size()) {
+        return;
+    }
+    //      :        
+    const auto terms_begin = removed_terms_.begin() + first_term;
+    sort(policy, terms_begin, removed_terms_.end());
+    vector<size_t> term_starts;
+    for (auto it = terms_begin; it != removed_terms_.end(); ++it) {
+        if (it == terms_begin || *it != *prev(it)) {
+            term_starts.push_back(it - removed_terms_.begin());
+        }
+    }
+    term_starts.push_back(removed_terms_.size());
+    vector<size_t> runs(term_starts.size() - 1);
+    iota(runs.begin(), runs.end(), 0);
+    VisitPostings([&](auto& index) {
+        for_each(policy, runs.begin(), runs.end(), [&](size_t run) {
+            index[removed_terms_[term_starts[run]]].MarkRemoved(term_starts[run + 1] - term_starts[run]);
+            });
+        });
+    CompactPostings(policy);
+}
 
+template <typename ExecutionPolicy>
+void SearchServer::CompactPostings(const ExecutionPolicy& policy) {
+    using namespace std;
+    sort(policy, removed_terms_.begin(), removed_terms_.end());
+    removed_terms_.erase(unique(removed_terms_.begin(), removed_terms_.end()), removed_terms_.end());
+    for (const TermId term_id : removed_terms_) {
+        CheckPostings(term_id);
+    }
+    const Bitmap& removed = documents_.GetRemovedBitmap();
+    //     ,          
+    VisitPostings([&](auto& index) {
+        for_each(policy, removed_terms_.begin(), removed_terms_.end(), [&index, &removed](TermId term_id) {
+            index[term_id].EraseDocuments(removed);
+            });
+        });
+    // ,     ,   ,     
+    VisitPostings([this](const auto& index) {
+        for (const TermId term_id : removed_terms_) {
+            if (index[term_id].empty()) {
+                terms_.Remove(term_id);
+            }
+        }
+        });
+    removed_terms_.clear();
+    removed_terms_.shrink_to_fit();
+    if (documents_.RemovedCount() > 0 && documents_.RemovedCount() >= GetDocumentCount()) {
+        RenumberDocuments(policy);
+    }
+}
 
+template <typename ExecutionPolicy>
+void SearchServer::RenumberDocuments(const ExecutionPolicy& policy) {
+    using namespace std;
+    CheckAllPostings();
+    //     ,     
+    const vector<int> new_ordinals = documents_.Compact();
+    forward_index_.Compact(new_ordinals);
+    VisitPostings([&](auto& index) {
+        for_each(policy, index.begin(), index.end(), [&new_ordinals](auto& postings) {
+            postings.Renumber(new_ordinals);
+            });
+        });
+    for (auto& [document_id, ordinal] : document_to_ordinal_) {
+        ordinal = new_ordinals[ordinal];
+    }
+    ++index_version_;
+}
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query,
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
     DocumentPredicate document_predicate) const {
+    return FindTopDocuments(raw_query, document_predicate, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t count, size_t offset, RetrievalMode mode) const {
+    return FindTopDocumentsByFilter(raw_query, MakeOrdinalFilter(document_predicate), count, offset, mode);
+}
+
+template <typename OrdinalFilter>
+std::vector<Document> SearchServer::FindTopDocumentsByFilter(std::string_view raw_query,
+    OrdinalFilter ordinal_filter, size_t count, size_t offset, RetrievalMode mode) const {
+    const auto query = ParseQuery(raw_query);
+
+    //          
+    return FindAllDocuments(query, ordinal_filter, TopDocuments::PageDepth(count, offset), mode).Extract(offset);
+}
+
+
+
+
+template <typename Score, typename Postings, typename OrdinalFilter>
+const ScoreAccumulator<Score>& SearchServer::AccumulateScores(const std::vector<Postings>& index, const Query& query, OrdinalFilter& ordinal_filter,
+    int first_ordinal, int last_ordinal) const {
     using namespace std;
-    map<int, double> document_to_relevance;
-    for (string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    //     ,    
+    static thread_local ScoreAccumulator<Score> accumulator;
+    accumulator.Reset(documents_.size());
+
+    // -           -
+    static thread_local vector<int> excluded;
+    static thread_local vector<uint32_t> positions;
+    excluded.clear();
+    for (const TermId term_id : query.minus_words) {
+        for (auto cursor = MakeCursor(index[term_id], first_ordinal, last_ordinal); !cursor.AtEnd(); cursor.NextChunk()) {
+            excluded.insert(excluded.end(), cursor.ChunkOrdinals(), cursor.ChunkOrdinals() + cursor.ChunkSize());
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    }
+    if (query.minus_words.size() > 1) {
+        sort(excluded.begin(), excluded.end());
+        excluded.erase(unique(excluded.begin(), excluded.end()), excluded.end());
+    }
+
+    for (size_t word = 0; word < query.plus_words.size(); ++word) {
+        const TermId term_id = query.plus_words[word];
+        const double inverse_document_freq = query.inverse_document_freqs[word];
+        const int* excluded_first = excluded.data();
+        const int* excluded_last = excluded.data() + excluded.size();
+        for (auto cursor = MakeCursor(index[term_id], first_ordinal, last_ordinal); !cursor.AtEnd(); cursor.NextChunk()) {
+            const int* ordinals = cursor.ChunkOrdinals();
+            const size_t size = cursor.ChunkSize();
+            const auto add = [&](size_t i) {
+                if (!ordinal_filter(ordinals[i])) {
+                    return;
+                }
+                if constexpr (is_floating_point_v<Score>) {
+                    accumulator.Add(ordinals[i], cursor.ChunkTermFreq(i) * inverse_document_freq);
+                }
+                else {
+                    accumulator.Add(ordinals[i], cursor.ChunkImpact(i));
+                }
+            };
+            if (excluded_first == excluded_last) {
+                for (size_t i = 0; i < size; ++i) {
+                    add(i);
+                }
+                continue;
             }
+            positions.resize(max(positions.size(), size));
+            const size_t kept = DifferencePositions(ordinals, size, excluded_first, excluded_last - excluded_first, positions.data());
+            for (size_t k = 0; k < kept; ++k) {
+                add(positions[k]);
+            }
+            excluded_first = upper_bound(excluded_first, excluded_last, ordinals[size - 1]);
         }
     }
-    for (string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    return accumulator;
+}
+
+template <typename Postings, typename OrdinalFilter>
+void SearchServer::AccumulateRelevance(const std::vector<Postings>& index, const Query& query, OrdinalFilter& ordinal_filter,
+    int first_ordinal, int last_ordinal, TopDocuments& top_documents) const {
+    const auto& accumulator = AccumulateScores<double>(index, query, ordinal_filter, first_ordinal, last_ordinal);
+    for (const int ordinal : accumulator.Touched()) {
+        top_documents.Push(
+            { documents_.GetId(ordinal), accumulator.GetScore(ordinal), documents_.GetRating(ordinal) });
+    }
+}
+
+template <typename Postings, typename OrdinalFilter>
+void SearchServer::CollectByMaxScore(const std::vector<Postings>& index, const Query& query, OrdinalFilter& ordinal_filter,
+    int first_ordinal, int last_ordinal, bool use_block_max, TopDocuments& top_documents) const {
+    using namespace std;
+    if (top_documents.Capacity() == 0) {
+        return;
+    }
+    //            
+    struct TermCursor {
+        typename Postings::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+        size_t query_index;
+    };
+    vector<TermCursor> cursors;
+    cursors.reserve(query.plus_words.size());
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const Postings& postings = index[query.plus_words[i]];
+        auto cursor = MakeCursor(postings, first_ordinal, last_ordinal);
+        if (cursor.AtEnd()) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        const double inverse_document_freq = query.inverse_document_freqs[i];
+        cursors.push_back({ cursor, inverse_document_freq, postings.MaxTermFreq() * inverse_document_freq, i });
+    }
+    vector<typename Postings::Cursor> minus_cursors;
+    minus_cursors.reserve(query.minus_words.size());
+    for (const TermId term_id : query.minus_words) {
+        minus_cursors.push_back(MakeCursor(index[term_id], first_ordinal, last_ordinal));
+    }
+
+    //     , max_score_sums[i] -    0..i
+    sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.max_score < rhs.max_score;
+        });
+    vector<double> max_score_sums(cursors.size());
+    double max_score_sum = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        max_score_sum += cursors[i].max_score;
+        max_score_sums[i] = max_score_sum;
+    }
+
+    //          ,  2*EPSILON 
+    //     IsBetter       
+    double threshold = -numeric_limits<double>::infinity();
+    //   first_essential    ,     
+    size_t first_essential = 0;
+    vector<double> contributions(query.plus_words.size());
+    //    ,    ,      0..i
+    vector<double> block_max_sums(cursors.size());
+    while (first_essential < cursors.size()) {
+        int candidate = last_ordinal;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].cursor.AtEnd()) {
+                candidate = min(candidate, cursors[i].cursor.Ordinal());
+            }
+        }
+        if (candidate == last_ordinal) {
+            break;
+        }
+        //    ,        
+        if (use_block_max && top_documents.IsFull()) {
+            double block_max_sum = 0.0;
+            //          
+            int blocks_end = last_ordinal;
+            for (size_t i = 0; i < cursors.size(); ++i) {
+                auto& cursor = cursors[i].cursor;
+                if (cursor.SeekBlock(candidate)) {
+                    block_max_sum += cursor.BlockMaxTermFreq() * cursors[i].inverse_document_freq;
+                    blocks_end = min(blocks_end, cursor.BlockLastOrdinal() + 1);
+                }
+                block_max_sums[i] = block_max_sum;
+            }
+            //         ,    
+            if (block_max_sum < threshold) {
+                for (size_t i = first_essential; i < cursors.size(); ++i) {
+                    cursors[i].cursor.Seek(blocks_end);
+                }
+                continue;
+            }
+        }
+        const bool accepted = ordinal_filter(candidate);
+        fill(contributions.begin(), contributions.end(), 0.0);
+        double score = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            auto& cursor = cursors[i].cursor;
+            if (!cursor.AtEnd() && cursor.Ordinal() == candidate) {
+                if (accepted) {
+                    const double contribution = cursor.TermFreq() * cursors[i].inverse_document_freq;
+                    contributions[cursors[i].query_index] = contribution;
+                    score += contribution;
+                }
+                cursor.Next();
+            }
+        }
+        if (!accepted) {
+            continue;
+        }
+        //      ,      
+        const vector<double>& remaining_max_sums = use_block_max && top_documents.IsFull() ? block_max_sums : max_score_sums;
+        bool pruned = false;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (score + remaining_max_sums[i] < threshold) {
+                pruned = true;
+                break;
+            }
+            auto& cursor = cursors[i].cursor;
+            cursor.Seek(candidate);
+            if (!cursor.AtEnd() && cursor.Ordinal() == candidate) {
+                const double contribution = cursor.TermFreq() * cursors[i].inverse_document_freq;
+                contributions[cursors[i].query_index] = contribution;
+                score += contribution;
+            }
+        }
+        if (pruned) {
+            continue;
+        }
+        bool excluded = false;
+        for (auto& cursor : minus_cursors) {
+            cursor.Seek(candidate);
+            if (!cursor.AtEnd() && cursor.Ordinal() == candidate) {
+                excluded = true;
+                break;
+            }
+        }
+        if (excluded) {
+            continue;
+        }
+        //       ,    
+        double relevance = 0.0;
+        for (const double contribution : contributions) {
+            relevance += contribution;
+        }
+        top_documents.Push({ documents_.GetId(candidate), relevance, documents_.GetRating(candidate) });
+        if (top_documents.IsFull()) {
+            threshold = top_documents.WorstRelevance() - 2 * TopDocuments::EPSILON;
+            while (first_essential < cursors.size() && max_score_sums[first_essential] < threshold) {
+                ++first_essential;
+            }
+        }
+    }
+}
+
+template <typename OrdinalFilter>
+void SearchServer::CollectByImpact(const Query& query, OrdinalFilter& ordinal_filter,
+    int first_ordinal, int last_ordinal, TopDocuments& top_documents, ImpactDeviation* deviation) const {
+    using namespace std;
+    const size_t capacity = top_documents.Capacity();
+    if (capacity == 0) {
+        return;
+    }
+    const auto& accumulator = AccumulateScores<uint32_t>(impact_index_.Postings(), query, ordinal_filter, first_ordinal, last_ordinal);
+    //   capacity-      .   
+    //     ,         ,
+    //            ;  2*EPSILON /    IsBetter
+    static thread_local vector<uint32_t> best_scores;
+    best_scores.clear();
+    for (const int ordinal : accumulator.Touched()) {
+        const uint32_t score = accumulator.GetScore(ordinal);
+        if (best_scores.size() < capacity) {
+            best_scores.push_back(score);
+            push_heap(best_scores.begin(), best_scores.end(), greater<>());
+        }
+        else if (score > best_scores.front()) {
+            pop_heap(best_scores.begin(), best_scores.end(), greater<>());
+            best_scores.back() = score;
+            push_heap(best_scores.begin(), best_scores.end(), greater<>());
+        }
+    }
+    double bound = 0.0;
+    if (best_scores.size() == capacity) {
+        bound = best_scores.front() - (query.plus_words.size() + ceil(2 * TopDocuments::EPSILON / impact_index_.Step()) + 1);
+    }
+    //     
+    static thread_local vector<pair<uint32_t, int>> candidates;
+    candidates.clear();
+    for (const int ordinal : accumulator.Touched()) {
+        const uint32_t score = accumulator.GetScore(ordinal);
+        if (score >= bound) {
+            candidates.push_back({ score, ordinal });
+        }
+    }
+    //     - capacity     
+    vector<int> quantized_top;
+    if (deviation != nullptr) {
+        const size_t quantized_top_count = min(capacity, candidates.size());
+        partial_sort(candidates.begin(), candidates.begin() + quantized_top_count, candidates.end(), greater<>());
+        for (size_t i = 0; i < quantized_top_count; ++i) {
+            quantized_top.push_back(candidates[i].second);
+        }
+        sort(quantized_top.begin(), quantized_top.end());
+    }
+
+    //     ,      ,    
+    sort(candidates.begin(), candidates.end(), [](const pair<uint32_t, int>& lhs, const pair<uint32_t, int>& rhs) {
+        return lhs.second < rhs.second;
+        });
+    static thread_local vector<double> relevances;
+    relevances.assign(candidates.size(), 0.0);
+    VisitPostings([&](const auto& index) {
+        for (size_t word = 0; word < query.plus_words.size(); ++word) {
+            const double inverse_document_freq = query.inverse_document_freqs[word];
+            auto cursor = MakeCursor(index[query.plus_words[word]], first_ordinal, last_ordinal);
+            for (size_t i = 0; i < candidates.size() && !cursor.AtEnd(); ++i) {
+                cursor.Seek(candidates[i].second);
+                if (!cursor.AtEnd() && cursor.Ordinal() == candidates[i].second) {
+                    relevances[i] += cursor.TermFreq() * inverse_document_freq;
+                }
+            }
         }
+        });
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const int ordinal = candidates[i].second;
+        top_documents.Push({ documents_.GetId(ordinal), relevances[i], documents_.GetRating(ordinal) });
     }
-    vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
+
+    if (deviation != nullptr) {
+        TopDocuments exact_top(capacity);
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            const int ordinal = candidates[i].second;
+            exact_top.Push({ ordinal, relevances[i], documents_.GetRating(ordinal) });
+            deviation->max_relevance_error = max(deviation->max_relevance_error,
+                abs(candidates[i].first * impact_index_.Step() - relevances[i]));
+        }
+        const auto exact_documents = exact_top.Extract();
+        deviation->candidate_count += candidates.size();
+        deviation->top_count += exact_documents.size();
+        for (const Document& document : exact_documents) {
+            deviation->top_overlap += binary_search(quantized_top.begin(), quantized_top.end(), document.id) ? 1 : 0;
+        }
     }
-    return matched_documents;
+}
+
+template <typename OrdinalFilter>
+void SearchServer::CollectTopDocuments(const Query& query, OrdinalFilter& ordinal_filter,
+    int first_ordinal, int last_ordinal, RetrievalMode mode, TopDocuments& top_documents) const {
+    VisitPostings([&](const auto& index) {
+        switch (mode) {
+        case RetrievalMode::MAX_SCORE:
+            CollectByMaxScore(index, query, ordinal_filter, first_ordinal, last_ordinal, false, top_documents);
+            break;
+        case RetrievalMode::BLOCK_MAX:
+            CollectByMaxScore(index, query, ordinal_filter, first_ordinal, last_ordinal, true, top_documents);
+            break;
+        case RetrievalMode::IMPACT:
+            if (impact_index_.IsCurrent(index_version_)) {
+                CollectByImpact(query, ordinal_filter, first_ordinal, last_ordinal, top_documents);
+            }
+            else {
+                AccumulateRelevance(index, query, ordinal_filter, first_ordinal, last_ordinal, top_documents);
+            }
+            break;
+        default:
+            AccumulateRelevance(index, query, ordinal_filter, first_ordinal, last_ordinal, top_documents);
+        }
+        });
+}
+
+template <typename OrdinalFilter>
+TopDocuments SearchServer::FindAllDocuments(const Query& query,
+    OrdinalFilter ordinal_filter, size_t top_count, RetrievalMode mode) const {
+    TopDocuments top_documents(top_count);
+    CollectTopDocuments(query, ordinal_filter, 0, static_cast<int>(documents_.size()), mode, top_documents);
+    return top_documents;
 }
 
 
 
 //       
-template <typename DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy policy, const Query& query,
-    DocumentPredicate document_predicate) const {
+template <typename OrdinalFilter, typename ExecutionPolicy>
+TopDocuments SearchServer::FindAllDocuments(const ExecutionPolicy policy, const Query& query,
+    OrdinalFilter ordinal_filter, size_t top_count, RetrievalMode mode) const {
     //     ,     
     if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
-        FindAllDocuments(query, document_predicate);
+        return FindAllDocuments(query, ordinal_filter, top_count, mode);
     }
     else {
         using namespace std;
-        ConcurrentMap<int, double> document_to_relevance(100);
-
-        for_each(execution::par, query.plus_words.begin(), query.plus_words.end(), [this, &document_to_relevance, &document_predicate](string_view word) {
-            if (word_to_document_freqs_.count(word) > 0) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
-                }
-            }
+        //      ,      
+        //     ,          
+        const int document_count = static_cast<int>(documents_.size());
+        const int part_count = static_cast<int>(max(1u, thread::hardware_concurrency())) * 4;
+        const int part_size = document_count / part_count + 1;
+        //       ,    
+        vector<TopDocuments> parts(part_count, TopDocuments(top_count));
+        vector<int> part_indexes(part_count);
+        iota(part_indexes.begin(), part_indexes.end(), 0);
+        for_each(policy, part_indexes.begin(), part_indexes.end(), [&](int part) {
+            const int first_ordinal = min(document_count, part * part_size);
+            const int last_ordinal = min(document_count, first_ordinal + part_size);
+            CollectTopDocuments(query, ordinal_filter, first_ordinal, last_ordinal, mode, parts[part]);
             });
 
-        for_each(execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](string_view word) {
-            if (word_to_document_freqs_.count(word) > 0) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.Erase(document_id);
-                }
-            }
-            });
-
-        vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-            matched_documents.push_back(
-                { document_id, relevance, documents_.at(document_id).rating });
+        TopDocuments top_documents(top_count);
+        for (const auto& part : parts) {
+            top_documents.Merge(part);
         }
-        return matched_documents;
-
+        return top_documents;
     }
-
 }
 
 
@@ -238,19 +980,19 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy polic
 // 2   FindTopdocuments     
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status) const {
-    //       FindTopDocuments    
+    return FindTopDocuments(policy, raw_query, status, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+    size_t count, size_t offset, RetrievalMode mode) const {
+    //       FindTopDocuments    
     if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
-        return FindTopDocuments(
-            raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+        return FindTopDocuments(raw_query, status, count, offset, mode);
     }
-    //     FindTopDocements    
+    //     FindTopDocements    
     else {
-        return FindTopDocuments(std::execution::par,
-            raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+        return FindTopDocumentsByFilter(std::execution::par, raw_query, MakeStatusFilter(status), count, offset, mode);
     }
 }
 //
@@ -258,30 +1000,26 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy polic
 template <typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query,
     DocumentPredicate document_predicate) const {
+    return FindTopDocuments(policy, raw_query, document_predicate, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t count, size_t offset, RetrievalMode mode) const {
     //       FindTopDocuments    
     if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
-        return FindTopDocuments(raw_query, document_predicate);
+        return FindTopDocuments(raw_query, document_predicate, count, offset, mode);
     }
     else {
-        const auto query = ParseQuery(raw_query);
-        //     
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-        constexpr double EPSILON = 1e-6;
-        //   
-        sort(std::execution::par, matched_documents.begin(), matched_documents.end(),
-            [EPSILON](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                    return lhs.rating > rhs.rating;
-                }
-                else {
-                    return lhs.relevance > rhs.relevance;
-                }
-            });
-
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
-        return matched_documents;
+        return FindTopDocumentsByFilter(policy, raw_query, MakeOrdinalFilter(document_predicate), count, offset, mode);
     }
 }
 
+template <typename OrdinalFilter, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsByFilter(const ExecutionPolicy policy, std::string_view raw_query,
+    OrdinalFilter ordinal_filter, size_t count, size_t offset, RetrievalMode mode) const {
+    const auto query = ParseQuery(raw_query);
+    //     
+    return FindAllDocuments(policy, query, ordinal_filter, TopDocuments::PageDepth(count, offset), mode).Extract(offset);
+}
+
@@ -0,0 +1,648 @@
+#include "segmented_search_server.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+size_t FindRemovedDocumentFreq(const vector<pair<TermId, size_t>>& removed_freqs, TermId term_id) {
+    const auto it = lower_bound(removed_freqs.begin(), removed_freqs.end(), pair{ term_id, size_t{ 0 } });
+    return it != removed_freqs.end() && it->first == term_id ? it->second : 0;
+}
+
+// сливает два отсортированных списка поправок, складывая поправки одного слова
+vector<pair<TermId, size_t>> MergeRemovedDocumentFreqs(const vector<pair<TermId, size_t>>& lhs,
+    const vector<pair<TermId, size_t>>& rhs) {
+    vector<pair<TermId, size_t>> result;
+    result.reserve(lhs.size() + rhs.size());
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() || rhs_it != rhs.end()) {
+        if (rhs_it == rhs.end() || (lhs_it != lhs.end() && lhs_it->first < rhs_it->first)) {
+            result.push_back(*lhs_it++);
+        }
+        else if (lhs_it == lhs.end() || rhs_it->first < lhs_it->first) {
+            result.push_back(*rhs_it++);
+        }
+        else {
+            result.push_back({ lhs_it->first, lhs_it->second + rhs_it->second });
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+size_t SegmentedSearchServer::Segment::GetDocumentCount() const {
+    return server->GetDocumentCount() - (deletes == nullptr ? 0 : deletes->removed_count);
+}
+
+size_t SegmentedSearchServer::Segment::GetOrdinalCount() const {
+    return server->documents_.size();
+}
+
+bool SegmentedSearchServer::Segment::IsRemoved(int ordinal) const {
+    return deletes != nullptr && deletes->removed.Test(ordinal);
+}
+
+size_t SegmentedSearchServer::Segment::GetDocumentFreq(TermId term_id) const {
+    size_t document_freq = server->VisitPostings([term_id](const auto& index) {
+        return index[term_id].DocumentFreq();
+        });
+    if (deletes != nullptr) {
+        document_freq -= FindRemovedDocumentFreq(*deletes->removed_document_freqs, term_id)
+            + FindRemovedDocumentFreq(deletes->recent_document_freqs, term_id);
+    }
+    return document_freq;
+}
+
+size_t SegmentedSearchServer::MemTableSegment::GetDocumentCount() const {
+    return ordinal_count - removed_count;
+}
+
+bool SegmentedSearchServer::MemTableSegment::IsRemoved(int ordinal) const {
+    return removed != nullptr && removed->Test(ordinal);
+}
+
+int SegmentedSearchServer::MemTableSegment::FindOrdinal(int document_id) const {
+    return table->FindOrdinal(document_id, ordinal_count, removed.get());
+}
+
+size_t SegmentedSearchServer::MemTableSegment::GetDocumentFreq(const MemTable::Term& term) const {
+    return table->GetDocumentFreq(term, ordinal_count, removed.get());
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const string& stop_words_text, SegmentOptions options)
+    : SegmentedSearchServer(SearchServer(stop_words_text), options) {
+}
+
+SegmentedSearchServer::SegmentedSearchServer(string_view stop_words_text, SegmentOptions options)
+    : SegmentedSearchServer(SearchServer(stop_words_text), options) {
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const SearchServer& prototype, SegmentOptions options)
+    : options_(options)
+    , stop_words_(prototype.stop_words_)
+    , version_(make_shared<const IndexVersion>(IndexVersion{ make_shared<const vector<Segment>>(), {}, 0 }))
+    , current_(version_) {
+    if (options_.memtable_size == 0 || options_.merge_factor < 2) {
+        throw invalid_argument("Invalid segment options"s);
+    }
+    merge_thread_ = thread([this]() { MergeLoop(); });
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        lock_guard lock(write_mutex_);
+        stopping_ = true;
+    }
+    merge_requested_.notify_all();
+    merge_thread_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    // проверка слов и разбиение текста идут без блокировки
+    const vector<ParsedDocument> documents{ { document_id, document, SearchServer::SplitIntoWordsNoStop(document, *stop_words_),
+        status, SearchServer::ComputeAverageRating(ratings) } };
+    lock_guard lock(write_mutex_);
+    if (HasDocument(*current_, document_id)) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    AddToMemTable(documents);
+}
+
+void SegmentedSearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    AddDocumentBatch(execution::seq, documents);
+}
+
+void SegmentedSearchServer::AddDocuments(const execution::sequenced_policy& policy, const vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents);
+}
+
+void SegmentedSearchServer::AddDocuments(const execution::parallel_policy& policy, const vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents);
+}
+
+template <typename ExecutionPolicy>
+void SegmentedSearchServer::AddDocumentBatch(const ExecutionPolicy& policy, const vector<NewDocument>& documents) {
+    if (documents.empty()) {
+        return;
+    }
+    // большой пакет не поместится в изменяемый сегмент и сразу собирается в неизменяемый
+    if (documents.size() >= options_.memtable_size) {
+        auto segment = MakeSegment();
+        segment->AddDocuments(policy, documents);
+        lock_guard lock(write_mutex_);
+        for (const NewDocument& document : documents) {
+            if (HasDocument(*current_, document.id)) {
+                throw invalid_argument("Invalid document_id"s);
+            }
+        }
+        AddSegment(move(segment));
+        return;
+    }
+    vector<vector<string_view>> document_words = SearchServer::SplitDocuments(policy, documents, *stop_words_);
+    vector<ParsedDocument> parsed_documents;
+    parsed_documents.reserve(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        parsed_documents.push_back({ documents[i].id, documents[i].text, move(document_words[i]), documents[i].status,
+            SearchServer::ComputeAverageRating(documents[i].ratings) });
+    }
+    lock_guard lock(write_mutex_);
+    for (const NewDocument& document : documents) {
+        if (HasDocument(*current_, document.id)) {
+            throw invalid_argument("Invalid document_id"s);
+        }
+    }
+    AddToMemTable(parsed_documents);
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    RemoveDocuments({ document_id });
+}
+
+void SegmentedSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    lock_guard lock(write_mutex_);
+    // номера удаляемых документов по сегментам обоих видов
+    map<size_t, vector<int>> removed_ordinals;
+    map<size_t, vector<int>> removed_memtable_ordinals;
+    const auto add_ordinal = [](vector<int>& ordinals, int ordinal) {
+        if (find(ordinals.begin(), ordinals.end(), ordinal) == ordinals.end()) {
+            ordinals.push_back(ordinal);
+        }
+    };
+    const vector<Segment>& segments = *current_->segments;
+    for (const int document_id : document_ids) {
+        const size_t segment_index = FindSegment(segments, document_id);
+        if (segment_index != segments.size()) {
+            add_ordinal(removed_ordinals[segment_index], segments[segment_index].server->document_to_ordinal_.at(document_id));
+            continue;
+        }
+        const auto [memtable_index, ordinal] = FindMemTable(current_->memtables, document_id);
+        if (ordinal >= 0) {
+            add_ordinal(removed_memtable_ordinals[memtable_index], ordinal);
+        }
+    }
+    if (removed_ordinals.empty() && removed_memtable_ordinals.empty()) {
+        return;
+    }
+    // список неизменяемых сегментов копируется, только если удаление их касается
+    shared_ptr<const vector<Segment>> next_segments = current_->segments;
+    if (!removed_ordinals.empty()) {
+        vector<Segment> changed_segments = segments;
+        for (const auto& [segment_index, ordinals] : removed_ordinals) {
+            changed_segments[segment_index] = RemoveFromSegment(changed_segments[segment_index], ordinals);
+        }
+        next_segments = make_shared<const vector<Segment>>(move(changed_segments));
+    }
+    vector<MemTableSegment> memtables = current_->memtables;
+    for (const auto& [memtable_index, ordinals] : removed_memtable_ordinals) {
+        memtables[memtable_index] = RemoveFromMemTable(memtables[memtable_index], ordinals);
+    }
+    Publish(move(next_segments), move(memtables));
+    if (!removed_ordinals.empty()) {
+        RequestMerge();
+    }
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, status, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status,
+    size_t count, size_t offset, RetrievalMode mode) const {
+    return FindTopDocuments(execution::seq, raw_query, status, count, offset, mode);
+}
+
+tuple<vector<string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    return MatchDocumentBy(execution::seq, raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(const execution::sequenced_policy& policy,
+    string_view raw_query, int document_id) const {
+    return MatchDocumentBy(policy, raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(const execution::parallel_policy& policy,
+    string_view raw_query, int document_id) const {
+    return MatchDocumentBy(policy, raw_query, document_id);
+}
+
+template <typename ExecutionPolicy>
+tuple<vector<string_view>, DocumentStatus> SegmentedSearchServer::MatchDocumentBy(const ExecutionPolicy& policy,
+    string_view raw_query, int document_id) const {
+    const auto version = LoadVersion();
+    const vector<Segment>& segments = *version->segments;
+    const size_t segment_index = FindSegment(segments, document_id);
+    const auto [memtable_index, ordinal] = segment_index == segments.size()
+        ? FindMemTable(version->memtables, document_id) : pair{ version->memtables.size(), -1 };
+    // пустой запрос проверяется раньше id, как у SearchServer
+    if (raw_query.empty()) {
+        throw invalid_argument("incorrect value");
+    }
+    if (segment_index == segments.size() && ordinal < 0) {
+        throw out_of_range("incorrect id");
+    }
+    auto [matched_words, status] = segment_index != segments.size()
+        ? segments[segment_index].server->MatchDocument(policy, raw_query, document_id)
+        : version->memtables[memtable_index].table->MatchDocument(raw_query, ordinal);
+    RebindToQuery(raw_query, matched_words);
+    return { matched_words, status };
+}
+
+void SegmentedSearchServer::Flush() {
+    lock_guard lock(write_mutex_);
+    if (memtable_ != nullptr) {
+        CloseMemTable();
+    }
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    unique_lock lock(write_mutex_);
+    merge_finished_.wait(lock, [this]() {
+        return merge_error_ || (!merging_ && FindClosedMemTable() == nullptr && PlanMerge(*current_->segments).empty());
+        });
+    if (merge_error_) {
+        rethrow_exception(merge_error_);
+    }
+}
+
+size_t SegmentedSearchServer::GetDocumentCount() const {
+    return LoadVersion()->document_count;
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    return LoadVersion()->segments->size();
+}
+
+shared_ptr<const SegmentedSearchServer::IndexVersion> SegmentedSearchServer::LoadVersion() const {
+    return atomic_load(&version_);
+}
+
+void SegmentedSearchServer::SetInverseDocumentFreqs(const IndexVersion& version, vector<SearchServer::Query>& queries,
+    vector<MemTable::Query>& memtable_queries) {
+    // логарифмы считаются так же, как в SearchServer, поэтому IDF совпадает до бита
+    const double log_document_count = log(static_cast<double>(version.document_count));
+    const vector<Segment>& segments = *version.segments;
+    map<string_view, double> inverse_document_freqs;
+    const auto get_inverse_document_freq = [&](string_view term) {
+        auto it = inverse_document_freqs.find(term);
+        if (it == inverse_document_freqs.end()) {
+            size_t document_freq = 0;
+            for (const Segment& segment : segments) {
+                const TermId term_id = segment.server->terms_.Find(term);
+                if (term_id != TermDictionary::NO_TERM) {
+                    document_freq += segment.GetDocumentFreq(term_id);
+                }
+            }
+            for (const MemTableSegment& memtable : version.memtables) {
+                if (const MemTable::Term* memtable_term = memtable.table->FindTerm(term)) {
+                    document_freq += memtable.GetDocumentFreq(*memtable_term);
+                }
+            }
+            it = inverse_document_freqs.emplace(term, log_document_count - log(static_cast<double>(document_freq))).first;
+        }
+        return it->second;
+    };
+    for (size_t i = 0; i < segments.size(); ++i) {
+        SearchServer::Query& query = queries[i];
+        for (size_t word = 0; word < query.plus_words.size(); ++word) {
+            query.inverse_document_freqs[word] = get_inverse_document_freq(segments[i].server->terms_.GetTerm(query.plus_words[word]));
+        }
+    }
+    for (MemTable::Query& query : memtable_queries) {
+        query.inverse_document_freqs.resize(query.plus_terms.size());
+        for (size_t word = 0; word < query.plus_terms.size(); ++word) {
+            query.inverse_document_freqs[word] = get_inverse_document_freq(query.plus_terms[word]->GetText());
+        }
+    }
+}
+
+unique_ptr<SearchServer> SegmentedSearchServer::MakeSegment() const {
+    // конструктор со стоп-словами другого сервера закрытый, make_unique его не видит
+    return unique_ptr<SearchServer>(new SearchServer(stop_words_, options_.posting_layout, options_.text_storage));
+}
+
+size_t SegmentedSearchServer::FindSegment(const vector<Segment>& segments, int document_id) {
+    // id удалённого документа мог быть добавлен заново, поэтому живой документ ищется во всех сегментах
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const auto& document_to_ordinal = segments[i].server->document_to_ordinal_;
+        const auto ordinal_it = document_to_ordinal.find(document_id);
+        if (ordinal_it != document_to_ordinal.end() && !segments[i].IsRemoved(ordinal_it->second)) {
+            return i;
+        }
+    }
+    return segments.size();
+}
+
+pair<size_t, int> SegmentedSearchServer::FindMemTable(const vector<MemTableSegment>& memtables, int document_id) {
+    for (size_t i = 0; i < memtables.size(); ++i) {
+        const int ordinal = memtables[i].FindOrdinal(document_id);
+        if (ordinal >= 0) {
+            return { i, ordinal };
+        }
+    }
+    return { memtables.size(), -1 };
+}
+
+bool SegmentedSearchServer::HasDocument(const IndexVersion& version, int document_id) {
+    return FindSegment(*version.segments, document_id) != version.segments->size()
+        || FindMemTable(version.memtables, document_id).second >= 0;
+}
+
+SegmentedSearchServer::Segment SegmentedSearchServer::RemoveFromSegment(const Segment& segment, const vector<int>& ordinals) {
+    auto deletes = segment.deletes != nullptr ? make_shared<SegmentDeletes>(*segment.deletes) : make_shared<SegmentDeletes>();
+    if (segment.deletes == nullptr) {
+        const size_t ordinal_count = segment.GetOrdinalCount();
+        deletes->removed = Bitmap(vector<uint64_t>((ordinal_count + 63) / 64), ordinal_count);
+        deletes->removed_document_freqs = make_shared<const vector<pair<TermId, size_t>>>();
+    }
+    vector<TermId> term_ids;
+    for (const int ordinal : ordinals) {
+        deletes->removed.Set(ordinal);
+        ++deletes->removed_count;
+        const auto document_terms = segment.server->forward_index_.Get(ordinal);
+        term_ids.insert(term_ids.end(), document_terms.term_ids, document_terms.term_ids + document_terms.size);
+    }
+    sort(term_ids.begin(), term_ids.end());
+    vector<pair<TermId, size_t>> removed_freqs;
+    for (const TermId term_id : term_ids) {
+        if (removed_freqs.empty() || removed_freqs.back().first != term_id) {
+            removed_freqs.push_back({ term_id, 0 });
+        }
+        ++removed_freqs.back().second;
+    }
+    deletes->recent_document_freqs = MergeRemovedDocumentFreqs(deletes->recent_document_freqs, removed_freqs);
+    const size_t merged_size = deletes->removed_document_freqs->size();
+    if (deletes->recent_document_freqs.size() * deletes->recent_document_freqs.size() > merged_size) {
+        deletes->removed_document_freqs = make_shared<const vector<pair<TermId, size_t>>>(
+            MergeRemovedDocumentFreqs(*deletes->removed_document_freqs, deletes->recent_document_freqs));
+        deletes->recent_document_freqs.clear();
+    }
+    return { segment.server, move(deletes) };
+}
+
+SegmentedSearchServer::MemTableSegment SegmentedSearchServer::RemoveFromMemTable(const MemTableSegment& memtable,
+    const vector<int>& ordinals) {
+    const size_t capacity = memtable.table->capacity();
+    auto removed = memtable.removed != nullptr ? make_shared<Bitmap>(*memtable.removed)
+        : make_shared<Bitmap>(vector<uint64_t>((capacity + 63) / 64), capacity);
+    for (const int ordinal : ordinals) {
+        removed->Set(ordinal);
+    }
+    return { memtable.table, memtable.ordinal_count, move(removed), memtable.removed_count + ordinals.size() };
+}
+
+void SegmentedSearchServer::AddToMemTable(const vector<ParsedDocument>& documents) {
+    if (memtable_ != nullptr && memtable_->size() + documents.size() > memtable_->capacity()) {
+        CloseMemTable();
+    }
+    if (memtable_ == nullptr) {
+        memtable_ = make_shared<MemTable>(stop_words_, options_.memtable_size, options_.text_storage == DocumentTextStorage::KEEP);
+    }
+    // документы дописываются за границей, которую видят читатели, и появляются в поиске с новой версией
+    for (const ParsedDocument& document : documents) {
+        memtable_->Add(document.id, document.text, document.words, document.status, document.rating);
+    }
+    vector<MemTableSegment> memtables = current_->memtables;
+    if (memtables.empty() || memtables.back().table != memtable_) {
+        memtables.push_back({ memtable_, 0, nullptr, 0 });
+    }
+    memtables.back().ordinal_count = memtable_->size();
+    Publish(current_->segments, move(memtables));
+    if (memtable_->size() == memtable_->capacity()) {
+        CloseMemTable();
+    }
+}
+
+void SegmentedSearchServer::CloseMemTable() {
+    // сегмент остаётся в версиях, пока фоновый поток не подменит его запечатанным
+    memtable_ = nullptr;
+    merge_requested_.notify_all();
+}
+
+void SegmentedSearchServer::AddSegment(unique_ptr<SearchServer> segment) {
+    vector<Segment> segments = *current_->segments;
+    segments.push_back({ move(segment), nullptr });
+    Publish(make_shared<const vector<Segment>>(move(segments)), current_->memtables);
+    RequestMerge();
+}
+
+void SegmentedSearchServer::RequestMerge() {
+    // пока фоновый поток занят, он сам проверит план, когда закончит
+    if (!merging_ && !PlanMerge(*current_->segments).empty()) {
+        merge_requested_.notify_all();
+    }
+}
+
+const SegmentedSearchServer::MemTableSegment* SegmentedSearchServer::FindClosedMemTable() const {
+    // закрытые сегменты старше того, что принимает документы
+    const vector<MemTableSegment>& memtables = current_->memtables;
+    if (memtables.empty() || memtables.front().table == memtable_) {
+        return nullptr;
+    }
+    return &memtables.front();
+}
+
+void SegmentedSearchServer::Publish(shared_ptr<const vector<Segment>> segments, vector<MemTableSegment> memtables) {
+    auto version = make_shared<IndexVersion>();
+    version->segments = move(segments);
+    version->memtables = move(memtables);
+    for (const Segment& segment : *version->segments) {
+        version->document_count += segment.GetDocumentCount();
+    }
+    for (const MemTableSegment& memtable : version->memtables) {
+        version->document_count += memtable.GetDocumentCount();
+    }
+    current_ = move(version);
+    atomic_store(&version_, current_);
+}
+
+vector<size_t> SegmentedSearchServer::PlanMerge(const vector<Segment>& segments) const {
+    // ярус сегмента: k, при котором memtable_size * merge_factor^k <= число документов < memtable_size * merge_factor^(k+1),
+    // сегменты меньше memtable_size - ярус 0
+    vector<vector<size_t>> tiers;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        size_t tier = 0;
+        for (size_t bound = options_.memtable_size * options_.merge_factor; segments[i].GetDocumentCount() >= bound;
+            bound *= options_.merge_factor) {
+            ++tier;
+        }
+        if (tier >= tiers.size()) {
+            tiers.resize(tier + 1);
+        }
+        tiers[tier].push_back(i);
+    }
+    // сливаются самые старые сегменты самого нижнего заполненного яруса
+    for (const auto& tier : tiers) {
+        if (tier.size() >= options_.merge_factor) {
+            return vector<size_t>(tier.begin(), tier.begin() + options_.merge_factor);
+        }
+    }
+    // сливать нечего - переписываем сегмент, в котором удалена половина документов
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const Segment& segment = segments[i];
+        if (2 * (segment.GetOrdinalCount() - segment.GetDocumentCount()) >= segment.GetOrdinalCount()) {
+            return { i };
+        }
+    }
+    return {};
+}
+
+unique_ptr<SearchServer> SegmentedSearchServer::BuildSegment(const vector<Segment>& inputs) const {
+    auto output = MakeSegment();
+    const Bitmap no_deletes;
+    for (const Segment& input : inputs) {
+        output->AppendDocuments(*input.server, input.deletes != nullptr ? input.deletes->removed : no_deletes);
+    }
+    return output;
+}
+
+vector<SegmentedSearchServer::Segment> SegmentedSearchServer::ReplaceSegments(const vector<Segment>& segments,
+    const vector<Segment>& inputs, unique_ptr<SearchServer> output) {
+    vector<Segment> result;
+    result.reserve(segments.size());
+    size_t position = segments.size();
+    for (const Segment& segment : segments) {
+        const auto input_it = find_if(inputs.begin(), inputs.end(), [&segment](const Segment& input) {
+            return input.server == segment.server;
+            });
+        if (input_it == inputs.end()) {
+            result.push_back(segment);
+            continue;
+        }
+        // документы, удалённые после того, как слияние взяло сегмент, удаляются и из результата
+        if (segment.deletes != input_it->deletes) {
+            for (int ordinal = 0; ordinal < static_cast<int>(segment.GetOrdinalCount()); ++ordinal) {
+                if (segment.IsRemoved(ordinal) && !input_it->IsRemoved(ordinal)) {
+                    output->RemoveDocument(segment.server->documents_.GetId(ordinal));
+                }
+            }
+        }
+        position = min(position, result.size());
+        retired_.Add(segment.server);
+    }
+    if (output->GetDocumentCount() > 0) {
+        result.insert(result.begin() + position, { move(output), nullptr });
+    }
+    return result;
+}
+
+template <typename Build>
+unique_ptr<SearchServer> SegmentedSearchServer::BuildUnlocked(unique_lock<mutex>& lock, Build build) {
+    // входы неизменяемы, поэтому сборка идёт без блокировки по входам текущей версии
+    merging_ = true;
+    lock.unlock();
+    unique_ptr<SearchServer> output;
+    exception_ptr error;
+    try {
+        output = build();
+    }
+    catch (...) {
+        error = current_exception();
+    }
+    lock.lock();
+    merging_ = false;
+    if (error) {
+        merge_error_ = error;
+    }
+    return output;
+}
+
+void SegmentedSearchServer::SealMemTable(unique_lock<mutex>& lock, MemTableSegment memtable) {
+    // писатель сегмент закрыл, поэтому ordinal_count уже не растёт
+    unique_ptr<SearchServer> output = BuildUnlocked(lock, [this, &memtable]() {
+        auto segment = MakeSegment();
+        segment->AppendDocuments(*memtable.table, memtable.ordinal_count, memtable.removed != nullptr ? *memtable.removed : Bitmap());
+        return segment;
+        });
+    if (output == nullptr) {
+        return;
+    }
+    vector<MemTableSegment> memtables = current_->memtables;
+    const auto memtable_it = find_if(memtables.begin(), memtables.end(), [&memtable](const MemTableSegment& current) {
+        return current.table == memtable.table;
+        });
+    // документы, удалённые во время сборки, удаляются и из результата
+    if (memtable_it->removed != memtable.removed) {
+        for (int ordinal = 0; ordinal < static_cast<int>(memtable.ordinal_count); ++ordinal) {
+            if (memtable_it->IsRemoved(ordinal) && !memtable.IsRemoved(ordinal)) {
+                output->RemoveDocument(memtable.table->GetDocument(ordinal).id);
+            }
+        }
+    }
+    memtables.erase(memtable_it);
+    vector<Segment> segments = *current_->segments;
+    if (output->GetDocumentCount() > 0) {
+        segments.push_back({ move(output), nullptr });
+    }
+    retired_.Add(move(memtable.table));
+    Publish(make_shared<const vector<Segment>>(move(segments)), move(memtables));
+}
+
+void SegmentedSearchServer::MergeSegments(unique_lock<mutex>& lock, const vector<size_t>& plan) {
+    vector<Segment> inputs;
+    for (const size_t i : plan) {
+        inputs.push_back((*current_->segments)[i]);
+    }
+    unique_ptr<SearchServer> output = BuildUnlocked(lock, [this, &inputs]() {
+        return BuildSegment(inputs);
+        });
+    if (output != nullptr) {
+        Publish(make_shared<const vector<Segment>>(ReplaceSegments(*current_->segments, inputs, move(output))), current_->memtables);
+    }
+}
+
+void SegmentedSearchServer::ReclaimSegments(unique_lock<mutex>& lock) {
+    // последняя ссылка - в retired_: сегмент не видит ни одна версия, а значит и ни один читатель
+    auto unused = retired_.ExtractUnused();
+    if (unused.empty()) {
+        return;
+    }
+    lock.unlock();
+    unused.clear();
+    lock.lock();
+}
+
+void SegmentedSearchServer::MergeLoop() {
+    unique_lock lock(write_mutex_);
+    while (true) {
+        ReclaimSegments(lock);
+        if (stopping_) {
+            return;
+        }
+        // сначала запечатываются закрытые изменяемые сегменты, потом сливаются неизменяемые
+        if (!merge_error_) {
+            if (const MemTableSegment* memtable = FindClosedMemTable()) {
+                SealMemTable(lock, *memtable);
+                merge_finished_.notify_all();
+                continue;
+            }
+            const vector<size_t> plan = PlanMerge(*current_->segments);
+            if (!plan.empty()) {
+                MergeSegments(lock, plan);
+                merge_finished_.notify_all();
+                continue;
+            }
+        }
+        if (retired_.empty()) {
+            merge_requested_.wait(lock);
+        }
+        else {
+            merge_requested_.wait_for(lock, RECLAIM_INTERVAL);
+        }
+    }
+}
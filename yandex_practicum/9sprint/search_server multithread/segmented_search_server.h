@@ -0,0 +1,342 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bitmap.h"
+#include "document.h"
+#include "index_publication.h"
+#include "memtable.h"
+#include "search_server.h"
+
+struct SegmentOptions {
+    // столько документов набирает изменяемый сегмент, прежде чем его запечатают в неизменяемый
+    size_t memtable_size = size_t{ 1 } << 12;
+    // столько сегментов одного яруса сливаются в один сегмент следующего яруса
+    size_t merge_factor = 4;
+    // формат списков неизменяемых сегментов
+    PostingLayout posting_layout = PostingLayout::PLAIN;
+    DocumentTextStorage text_storage = DocumentTextStorage::DISCARD;
+};
+
+// индекс из сегментов: новые документы дописываются в изменяемый сегмент (MemTable), заполненный сегмент
+// фоновый поток запечатывает в неизменяемый SearchServer и сливает неизменяемые сегменты по ярусам:
+// сегменты с числом документов в [memtable_size * merge_factor^k, memtable_size * merge_factor^(k+1)) образуют ярус k,
+// и merge_factor самых старых сегментов яруса сливаются в один. удаление документа только отмечается в копии
+// карты удалений сегмента и учитывается при слиянии; сегмент, где удалена половина документов, переписывается.
+// поиск идёт по всем сегментам с IDF по всему индексу, поэтому выдача та же, что у одного SearchServer
+// с теми же документами, с точностью до порядка сложения вкладов слов.
+// неизменяемая версия индекса - список сегментов с картами удалений и число документов изменяемого сегмента,
+// которые в ней видны. запрос берёт указатель на текущую версию и до конца видит только её, не дожидаясь писателей;
+// запись дописывает документы в изменяемый сегмент за видимой границей и подменяет указатель на версию с новой границей,
+// поэтому изменение видно целиком или не видно совсем. сегменты, выпавшие из всех версий, освобождает фоновый поток.
+// методы можно вызывать из разных потоков, записи выполняются по очереди
+class SegmentedSearchServer {
+public:
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words, SegmentOptions options = {});
+    explicit SegmentedSearchServer(const std::string& stop_words_text, SegmentOptions options = {});
+    explicit SegmentedSearchServer(std::string_view stop_words_text, SegmentOptions options = {});
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+    // останавливает фоновое слияние, не дожидаясь запланированных слияний
+    ~SegmentedSearchServer();
+
+    // текст разбирается до того, как запись встанет в очередь
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // пакет появляется в поиске целиком. пакет от memtable_size документов сразу собирается в неизменяемый сегмент
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+    void RemoveDocument(int document_id);
+    // документы пакета исчезают из поиска одновременно
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+    // RetrievalMode::IMPACT считается полным перебором: квантованные вклады сегментов посчитаны по их собственным IDF
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t count, size_t offset = 0,
+        RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status, size_t count, size_t offset = 0,
+        RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+
+    // с параллельной политикой сегменты просматриваются параллельно
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+        size_t count = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0, RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate,
+        size_t count = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0, RetrievalMode mode = RetrievalMode::EXHAUSTIVE) const;
+
+    // найденные слова ссылаются на raw_query, а не на словарь сегмента, который может быть освобождён
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+
+    // закрывает изменяемый сегмент, даже если он не заполнен: фоновый поток запечатает его,
+    // а следующий документ начнёт новый изменяемый сегмент
+    void Flush();
+    // ждёт, пока фоновый поток не запечатает закрытые изменяемые сегменты и не выполнит все запланированные слияния;
+    // бросает исключение, на котором фоновая работа остановилась
+    void WaitForMerges();
+
+    size_t GetDocumentCount() const;
+    // число неизменяемых сегментов, без изменяемых
+    size_t GetSegmentCount() const;
+
+private:
+    // удаления в неизменяемом сегменте. версии не меняются, поэтому удаление копирует их
+    struct SegmentDeletes {
+        // удалённые документы по порядковому номеру сегмента
+        Bitmap removed;
+        // на сколько уменьшилось число документов со словом, по возрастанию номера слова.
+        // копировать весь список на каждое удаление дорого, поэтому свежие поправки копятся
+        // в коротком recent_document_freqs и вливаются в общий список, когда их станет sqrt от него
+        std::shared_ptr<const std::vector<std::pair<TermId, size_t>>> removed_document_freqs;
+        std::vector<std::pair<TermId, size_t>> recent_document_freqs;
+        size_t removed_count = 0;
+    };
+
+    struct Segment {
+        std::shared_ptr<const SearchServer> server;
+        // nullptr, пока в сегменте ничего не удалено
+        std::shared_ptr<const SegmentDeletes> deletes;
+
+        size_t GetDocumentCount() const;
+        // число порядковых номеров вместе с удалёнными документами
+        size_t GetOrdinalCount() const;
+        bool IsRemoved(int ordinal) const;
+        size_t GetDocumentFreq(TermId term_id) const;
+    };
+
+    // изменяемый сегмент в версии индекса
+    struct MemTableSegment {
+        std::shared_ptr<const MemTable> table;
+        // сколько первых документов сегмента видно в этой версии
+        size_t ordinal_count = 0;
+        // nullptr, пока в сегменте ничего не удалено
+        std::shared_ptr<const Bitmap> removed;
+        size_t removed_count = 0;
+
+        size_t GetDocumentCount() const;
+        bool IsRemoved(int ordinal) const;
+        // номер живого документа document_id или -1
+        int FindOrdinal(int document_id) const;
+        size_t GetDocumentFreq(const MemTable::Term& term) const;
+    };
+
+    struct IndexVersion {
+        // неизменяемые сегменты от старых к новым. запись в изменяемый сегмент публикует версию
+        // с тем же списком, не копируя его
+        std::shared_ptr<const std::vector<Segment>> segments;
+        // изменяемые сегменты от старых к новым. документы принимает последний, пока писатель его не закрыл,
+        // остальные закрыты и ждут, пока фоновый поток их запечатает
+        std::vector<MemTableSegment> memtables;
+        size_t document_count = 0;
+    };
+
+    // разобранный документ, который ждёт записи в изменяемый сегмент
+    struct ParsedDocument {
+        int id;
+        std::string_view text;
+        std::vector<std::string_view> words;
+        DocumentStatus status;
+        int rating;
+    };
+
+    explicit SegmentedSearchServer(const SearchServer& prototype, SegmentOptions options);
+
+    std::shared_ptr<const IndexVersion> LoadVersion() const;
+    // подставляет в запросы сегментов IDF по всем сегментам: log(N) - log(df), где N и df - суммы по сегментам
+    static void SetInverseDocumentFreqs(const IndexVersion& version, std::vector<SearchServer::Query>& queries,
+        std::vector<MemTable::Query>& memtable_queries);
+
+    // make_filter(сегмент) возвращает фильтр по номерам документов SearchServer или MemTable
+    template <typename FilterFactory, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsByFilter(const ExecutionPolicy& policy, std::string_view raw_query, FilterFactory make_filter,
+        size_t count, size_t offset, RetrievalMode mode) const;
+    template <typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocumentBy(const ExecutionPolicy& policy, std::string_view raw_query,
+        int document_id) const;
+    template <typename ExecutionPolicy>
+    void AddDocumentBatch(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents);
+
+    // пустой сегмент со стоп-словами и форматом индекса
+    std::unique_ptr<SearchServer> MakeSegment() const;
+    // номер неизменяемого сегмента с живым документом document_id или segments.size()
+    static size_t FindSegment(const std::vector<Segment>& segments, int document_id);
+    // номер изменяемого сегмента с живым документом document_id и номер документа в нём или { memtables.size(), -1 }
+    static std::pair<size_t, int> FindMemTable(const std::vector<MemTableSegment>& memtables, int document_id);
+    static bool HasDocument(const IndexVersion& version, int document_id);
+    // копии сегментов с удалёнными документами ordinals
+    static Segment RemoveFromSegment(const Segment& segment, const std::vector<int>& ordinals);
+    static MemTableSegment RemoveFromMemTable(const MemTableSegment& memtable, const std::vector<int>& ordinals);
+
+    // ниже - методы писателя, они вызываются под write_mutex_
+    // дописывает документы в изменяемый сегмент и публикует версию, в которой они видны все сразу
+    void AddToMemTable(const std::vector<ParsedDocument>& documents);
+    // закрывает изменяемый сегмент и будит фоновый поток
+    void CloseMemTable();
+    void AddSegment(std::unique_ptr<SearchServer> segment);
+    void Publish(std::shared_ptr<const std::vector<Segment>> segments, std::vector<MemTableSegment> memtables);
+    // будит фоновый поток, если ему есть что делать
+    void RequestMerge();
+    // закрытый изменяемый сегмент, который ещё не запечатан, или nullptr
+    const MemTableSegment* FindClosedMemTable() const;
+
+    // номера сегментов для следующего слияния или пустой вектор
+    std::vector<size_t> PlanMerge(const std::vector<Segment>& segments) const;
+    std::unique_ptr<SearchServer> BuildSegment(const std::vector<Segment>& inputs) const;
+    // заменяет входные сегменты результатом слияния, удаляя из него документы, удалённые во время слияния
+    std::vector<Segment> ReplaceSegments(const std::vector<Segment>& segments, const std::vector<Segment>& inputs,
+        std::unique_ptr<SearchServer> output);
+    // запечатывает закрытый изменяемый сегмент memtable в неизменяемый
+    void SealMemTable(std::unique_lock<std::mutex>& lock, MemTableSegment memtable);
+    void MergeSegments(std::unique_lock<std::mutex>& lock, const std::vector<size_t>& plan);
+    // выполняет build без блокировки; исключение запоминается в merge_error_, тогда возвращается nullptr
+    template <typename Build>
+    std::unique_ptr<SearchServer> BuildUnlocked(std::unique_lock<std::mutex>& lock, Build build);
+    // освобождает сегменты, на которые не ссылается ни одна версия
+    void ReclaimSegments(std::unique_lock<std::mutex>& lock);
+    void MergeLoop();
+
+    // пока есть неосвобождённые сегменты, фоновый поток проверяет их с таким интервалом
+    static constexpr std::chrono::milliseconds RECLAIM_INTERVAL{ 10 };
+
+    const SegmentOptions options_;
+    // один проверенный набор стоп-слов на все сегменты
+    const std::shared_ptr<const std::set<std::string, std::less<>>> stop_words_;
+    // читатели берут версию через std::atomic_load, писатель подменяет её через std::atomic_store
+    std::shared_ptr<const IndexVersion> version_;
+
+    // ниже - состояние писателей и фонового потока под write_mutex_
+    std::mutex write_mutex_;
+    // последняя опубликованная версия, писатель читает её без atomic_load
+    std::shared_ptr<const IndexVersion> current_;
+    // изменяемый сегмент, который принимает документы, - последний в current_->memtables; nullptr, пока его закрыли
+    // и следующий документ ещё не начал новый
+    std::shared_ptr<MemTable> memtable_;
+    // сегменты обоих видов, выпавшие из текущей версии; старые версии у читателей ещё могут на них ссылаться
+    RetiredList<> retired_;
+    // фоновый поток запечатывает или сливает сегменты без блокировки
+    bool merging_ = false;
+    std::condition_variable merge_requested_;
+    std::condition_variable merge_finished_;
+    bool stopping_ = false;
+    std::exception_ptr merge_error_;
+    std::thread merge_thread_;
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer& stop_words, SegmentOptions options)
+    : SegmentedSearchServer(SearchServer(stop_words), options) {
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(raw_query, document_predicate, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+    size_t count, size_t offset, RetrievalMode mode) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, count, offset, mode);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status,
+    size_t count, size_t offset, RetrievalMode mode) const {
+    return FindTopDocumentsByFilter(policy, raw_query, [status](const auto& segment) {
+        return segment.MakeStatusFilter(status);
+        }, count, offset, mode);
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const ExecutionPolicy policy, std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t count, size_t offset, RetrievalMode mode) const {
+    return FindTopDocumentsByFilter(policy, raw_query, [&document_predicate](const auto& segment) {
+        return segment.MakeOrdinalFilter(document_predicate);
+        }, count, offset, mode);
+}
+
+template <typename FilterFactory, typename ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocumentsByFilter(const ExecutionPolicy& policy, std::string_view raw_query,
+    FilterFactory make_filter, size_t count, size_t offset, RetrievalMode mode) const {
+    using namespace std;
+    // квантованные вклады сегмента посчитаны по его IDF, с общим IDF их порог неверен
+    if (mode == RetrievalMode::IMPACT) {
+        mode = RetrievalMode::EXHAUSTIVE;
+    }
+    const size_t top_count = TopDocuments::PageDepth(count, offset);
+    const auto version = LoadVersion();
+    const vector<Segment>& segments = *version->segments;
+    const vector<MemTableSegment>& memtables = version->memtables;
+    vector<SearchServer::Query> queries(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        queries[i] = segments[i].server->ParseQuery(raw_query);
+    }
+    vector<MemTable::Query> memtable_queries(memtables.size());
+    for (size_t i = 0; i < memtables.size(); ++i) {
+        memtable_queries[i] = memtables[i].table->ParseQuery(raw_query);
+    }
+    SetInverseDocumentFreqs(*version, queries, memtable_queries);
+
+    // у каждого сегмента своя куча лучших документов, в конце они сливаются
+    vector<TopDocuments> parts(segments.size() + memtables.size(), TopDocuments(top_count));
+    vector<size_t> part_indexes(parts.size());
+    iota(part_indexes.begin(), part_indexes.end(), 0);
+    for_each(policy, part_indexes.begin(), part_indexes.end(), [&](size_t part) {
+        if (part >= segments.size()) {
+            const MemTableSegment& memtable = memtables[part - segments.size()];
+            const MemTable::Query& query = memtable_queries[part - segments.size()];
+            auto ordinal_filter = make_filter(*memtable.table);
+            if (memtable.removed == nullptr) {
+                parts[part] = memtable.table->FindAllDocuments(query, ordinal_filter, memtable.ordinal_count, top_count);
+            }
+            else {
+                parts[part] = memtable.table->FindAllDocuments(query, [&ordinal_filter, &removed = *memtable.removed](int ordinal) {
+                    return !removed.Test(ordinal) && ordinal_filter(ordinal);
+                    }, memtable.ordinal_count, top_count);
+            }
+            return;
+        }
+        const Segment& segment = segments[part];
+        auto ordinal_filter = make_filter(*segment.server);
+        // пока в сегменте ничего не удалено, карту удалений не проверяем
+        if (segment.deletes == nullptr) {
+            parts[part] = segment.server->FindAllDocuments(queries[part], ordinal_filter, top_count, mode);
+        }
+        else {
+            parts[part] = segment.server->FindAllDocuments(queries[part], [&ordinal_filter, &removed = segment.deletes->removed](int ordinal) {
+                return !removed.Test(ordinal) && ordinal_filter(ordinal);
+                }, top_count, mode);
+        }
+        });
+    TopDocuments top_documents(top_count);
+    for (const auto& part : parts) {
+        top_documents.Merge(part);
+    }
+    return top_documents.Extract(offset);
+}
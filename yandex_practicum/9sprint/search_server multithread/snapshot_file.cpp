@@ -0,0 +1,84 @@
+#include "snapshot_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        throw runtime_error("Cannot map "s + path);
+    }
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // отображение держит файл само, дескриптор больше не нужен
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw runtime_error("Cannot map "s + path);
+    }
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<size_t>(file_stat.st_size);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data_), size_);
+}
+
+SnapshotWriter::SnapshotWriter(ostream& out)
+    : out_(out) {
+    const SnapshotPrefix prefix{};
+    out_.write(reinterpret_cast<const char*>(&prefix), sizeof(prefix));
+    position_ = sizeof(prefix);
+}
+
+void SnapshotWriter::Finish(SnapshotArray root) {
+    const SnapshotPrefix prefix{ SNAPSHOT_FILE_MAGIC, SNAPSHOT_FILE_VERSION, root };
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&prefix), sizeof(prefix));
+    out_.flush();
+    if (!out_) {
+        throw runtime_error("Cannot write snapshot file"s);
+    }
+}
+
+void SnapshotWriter::Align() {
+    static const char zeros[8] = {};
+    const size_t padding = (8 - position_ % 8) % 8;
+    out_.write(zeros, padding);
+    position_ += padding;
+}
+
+SnapshotReader::SnapshotReader(shared_ptr<const MappedFile> file)
+    : file_(move(file)) {
+    if (file_->size() < sizeof(SnapshotPrefix)) {
+        throw runtime_error("Snapshot file is damaged"s);
+    }
+    const auto& prefix = *reinterpret_cast<const SnapshotPrefix*>(file_->data());
+    if (prefix.magic != SNAPSHOT_FILE_MAGIC || prefix.version != SNAPSHOT_FILE_VERSION) {
+        throw runtime_error("Unsupported snapshot file"s);
+    }
+    root_ = prefix.root;
+}
+
+vector<string_view> SnapshotReader::Strings(SnapshotStrings strings) const {
+    const MappedArray<char> chars = Array<char>(strings.chars);
+    const MappedArray<uint64_t> offsets = Array<uint64_t>(strings.offsets);
+    vector<string_view> result;
+    if (offsets.empty()) {
+        return result;
+    }
+    result.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > chars.size()) {
+            throw runtime_error("Snapshot file is damaged"s);
+        }
+        result.emplace_back(chars.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return result;
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "mapped_array.h"
+
+// снимок индекса - файл из массивов простых структур, каждый выровнен по 8 байт, поэтому после mmap
+// массивы читаются прямо из страниц файла. в начале файла лежит SnapshotPrefix со ссылкой на корневую
+// структуру, в которой хранятся ссылки на остальные массивы. числа записаны в порядке байт машины
+constexpr uint32_t SNAPSHOT_FILE_MAGIC = 0x50534E53; // "SNSP"
+constexpr uint32_t SNAPSHOT_FILE_VERSION = 1;
+
+// положение массива в файле: смещение в байтах и число элементов
+struct SnapshotArray {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// набор строк: байты всех строк подряд и смещения начал, строк на одну меньше, чем смещений
+struct SnapshotStrings {
+    SnapshotArray chars;
+    SnapshotArray offsets;
+};
+
+struct SnapshotPrefix {
+    uint32_t magic;
+    uint32_t version;
+    SnapshotArray root;
+};
+
+// файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+class SnapshotWriter {
+public:
+    // место под SnapshotPrefix резервируется сразу, заполняется в Finish
+    explicit SnapshotWriter(std::ostream& out);
+
+    template <typename T>
+    SnapshotArray Write(const T* data, size_t size);
+    template <typename T>
+    SnapshotArray Write(const std::vector<T>& values) {
+        return Write(values.data(), values.size());
+    }
+    template <typename T>
+    SnapshotArray Write(const MappedArray<T>& values) {
+        return Write(values.data(), values.size());
+    }
+    template <typename T>
+    SnapshotArray WriteValue(const T& value) {
+        return Write(&value, 1);
+    }
+    template <typename StringContainer>
+    SnapshotStrings WriteStrings(const StringContainer& strings);
+
+    // записывает префикс со ссылкой на корневую структуру; бросает runtime_error, если запись не удалась
+    void Finish(SnapshotArray root);
+
+private:
+    void Align();
+
+    std::ostream& out_;
+    uint64_t position_ = 0;
+};
+
+// читает массивы снимка из отображённого файла, проверяя их границы
+class SnapshotReader {
+public:
+    explicit SnapshotReader(std::shared_ptr<const MappedFile> file);
+
+    SnapshotArray Root() const {
+        return root_;
+    }
+    // массив смотрит в страницы файла, файл должен жить дольше массива
+    template <typename T>
+    MappedArray<T> Array(SnapshotArray array) const;
+    template <typename T>
+    const T& Value(SnapshotArray array) const;
+    // строки смотрят в страницы файла
+    std::vector<std::string_view> Strings(SnapshotStrings strings) const;
+
+private:
+    template <typename T>
+    const T* Data(SnapshotArray array) const;
+
+    std::shared_ptr<const MappedFile> file_;
+    SnapshotArray root_;
+};
+
+template <typename T>
+SnapshotArray SnapshotWriter::Write(const T* data, size_t size) {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+    Align();
+    const SnapshotArray array{ position_, size };
+    out_.write(reinterpret_cast<const char*>(data), size * sizeof(T));
+    position_ += size * sizeof(T);
+    return array;
+}
+
+template <typename StringContainer>
+SnapshotStrings SnapshotWriter::WriteStrings(const StringContainer& strings) {
+    std::string chars;
+    std::vector<uint64_t> offsets = { 0 };
+    for (const auto& str : strings) {
+        chars += str;
+        offsets.push_back(chars.size());
+    }
+    return { Write(chars.data(), chars.size()), Write(offsets) };
+}
+
+template <typename T>
+const T* SnapshotReader::Data(SnapshotArray array) const {
+    using namespace std::literals;
+    if (array.offset > file_->size() || array.size > (file_->size() - array.offset) / sizeof(T)
+        || array.offset % alignof(T) != 0) {
+        throw std::runtime_error("Snapshot file is damaged"s);
+    }
+    return reinterpret_cast<const T*>(file_->data() + array.offset);
+}
+
+template <typename T>
+MappedArray<T> SnapshotReader::Array(SnapshotArray array) const {
+    return MappedArray<T>::View(Data<T>(array), array.size);
+}
+
+template <typename T>
+const T& SnapshotReader::Value(SnapshotArray array) const {
+    using namespace std::literals;
+    if (array.size != 1) {
+        throw std::runtime_error("Snapshot file is damaged"s);
+    }
+    return *Data<T>(array);
+}
@@ -0,0 +1,18 @@
+#include "string_processing.h"
+
+using namespace std;
+
+vector<string_view> SplitIntoWords(string_view text) {
+    vector<string_view> words;
+    while (!text.empty()) {
+        const size_t space = text.find(' ');
+        if (space != 0) {
+            words.push_back(text.substr(0, space));
+        }
+        if (space == text.npos) {
+            break;
+        }
+        text.remove_prefix(space + 1);
+    }
+    return words;
+}
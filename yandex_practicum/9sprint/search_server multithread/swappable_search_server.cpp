@@ -0,0 +1,117 @@
+#include "swappable_search_server.h"
+#include <algorithm>
+#include <atomic>
+#include "process_memory.h"
+
+using namespace std;
+
+SwappableSearchServer::SwappableSearchServer(SearchServer index)
+    : current_(make_shared<const SearchServer>(move(index))) {
+    reclaim_thread_ = thread([this]() { ReclaimLoop(); });
+}
+
+SwappableSearchServer::~SwappableSearchServer() {
+    {
+        lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    retired_added_.notify_all();
+    reclaim_thread_.join();
+}
+
+void SwappableSearchServer::Swap(SearchServer index) {
+    shared_ptr<const SearchServer> next = make_shared<const SearchServer>(move(index));
+    // новый индекс уже собран, старый ещё жив: с этого момента в памяти оба, и пик считается заново
+    const bool peak_reset = ResetPeakResidentBytes();
+    const auto start = chrono::steady_clock::now();
+    lock_guard lock(mutex_);
+    peak_reset_ = peak_reset;
+    shared_ptr<const SearchServer> previous = atomic_exchange(&current_, move(next));
+    const auto published = chrono::steady_clock::now();
+    ++swap_count_;
+    retired_.Add(move(previous), { published, swap_count_ });
+    last_stats_ = IndexSwapStats{};
+    last_stats_.swap_latency = published - start;
+    retired_added_.notify_all();
+}
+
+IndexSwapStats SwappableSearchServer::WaitForReclaim() {
+    unique_lock lock(mutex_);
+    reclaimed_.wait(lock, [this]() { return retired_.empty() && !reclaiming_; });
+    return last_stats_;
+}
+
+IndexSwapStats SwappableSearchServer::GetLastSwapStats() const {
+    lock_guard lock(mutex_);
+    return last_stats_;
+}
+
+shared_ptr<const SearchServer> SwappableSearchServer::Acquire() const {
+    return atomic_load(&current_);
+}
+
+tuple<vector<string_view>, DocumentStatus> SwappableSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    return MatchDocumentBy(execution::seq, raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SwappableSearchServer::MatchDocument(const execution::sequenced_policy& policy,
+    string_view raw_query, int document_id) const {
+    return MatchDocumentBy(policy, raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> SwappableSearchServer::MatchDocument(const execution::parallel_policy& policy,
+    string_view raw_query, int document_id) const {
+    return MatchDocumentBy(policy, raw_query, document_id);
+}
+
+template <typename ExecutionPolicy>
+tuple<vector<string_view>, DocumentStatus> SwappableSearchServer::MatchDocumentBy(const ExecutionPolicy& policy,
+    string_view raw_query, int document_id) const {
+    const auto index = Acquire();
+    auto [matched_words, status] = index->MatchDocument(policy, raw_query, document_id);
+    RebindToQuery(raw_query, matched_words);
+    return { matched_words, status };
+}
+
+size_t SwappableSearchServer::GetDocumentCount() const {
+    return Acquire()->GetDocumentCount();
+}
+
+void SwappableSearchServer::ReclaimLoop() {
+    unique_lock lock(mutex_);
+    while (!stopping_) {
+        if (retired_.empty()) {
+            retired_added_.wait(lock);
+            continue;
+        }
+        // последняя ссылка - в retired_: индекс не держит ни один запрос
+        auto unused = retired_.ExtractUnused();
+        if (unused.empty()) {
+            retired_added_.wait_for(lock, RECLAIM_INTERVAL);
+            continue;
+        }
+        const auto reclaimed_at = chrono::steady_clock::now();
+        const uint64_t last_swap = swap_count_;
+        const auto last_it = find_if(unused.begin(), unused.end(), [last_swap](const auto& retired) {
+            return retired.tag.swap_number == last_swap;
+            });
+        const bool last_reclaimed = last_it != unused.end();
+        const auto retired_at = last_reclaimed ? last_it->tag.retired_at : reclaimed_at;
+        // пик снимается, пока индекс последней подмены ещё в памяти; сбросила его эта же подмена
+        const size_t peak_resident_bytes = last_reclaimed && peak_reset_ ? GetPeakResidentBytes() : 0;
+        // освобождение большого индекса долгое, Swap и запросы его не ждут
+        reclaiming_ = true;
+        lock.unlock();
+        unused.clear();
+        const size_t resident_bytes = GetResidentBytes();
+        lock.lock();
+        reclaiming_ = false;
+        // за время освобождения могла пройти новая подмена, тогда статистика уже её
+        if (last_reclaimed && swap_count_ == last_swap) {
+            last_stats_.drain_time = reclaimed_at - retired_at;
+            last_stats_.peak_resident_bytes = peak_resident_bytes;
+            last_stats_.resident_bytes_after = resident_bytes;
+        }
+        reclaimed_.notify_all();
+    }
+}
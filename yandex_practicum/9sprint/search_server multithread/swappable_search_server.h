@@ -0,0 +1,102 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "document.h"
+#include "index_publication.h"
+#include "search_server.h"
+
+struct IndexSwapStats {
+    // сколько заняла публикация нового индекса, без его сборки
+    std::chrono::nanoseconds swap_latency{ 0 };
+    // от публикации до освобождения старого индекса: столько его держали начатые до подмены запросы.
+    // фоновый поток проверяет индекс раз в RECLAIM_INTERVAL, отсюда и точность
+    std::chrono::nanoseconds drain_time{ 0 };
+    // наибольший resident size процесса (VmHWM) от подмены до освобождения старого индекса: ядро сбрасывает
+    // пик при подмене и отслеживает его постранично, поэтому кратковременный рост между проверками не теряется.
+    // пик общий для процесса и включает память других потоков. resident_bytes_after - resident size
+    // после освобождения; аллокатор может оставить освобождённую память процессу, тогда он не уменьшится.
+    // 0, если /proc недоступен или ядро не дало сбросить пик
+    size_t peak_resident_bytes = 0;
+    size_t resident_bytes_after = 0;
+};
+
+// владеет текущим индексом через атомарно подменяемый указатель. запрос берёт указатель
+// и работает с этим индексом до конца, поэтому Swap не ждёт запросы, а запросы не ждут Swap.
+// заменённый индекс освобождает фоновый поток, когда его отпустит последний запрос;
+// до этого в памяти лежат оба индекса, и статистика подмены показывает, сколько это стоило
+class SwappableSearchServer {
+public:
+    explicit SwappableSearchServer(SearchServer index);
+    SwappableSearchServer(const SwappableSearchServer&) = delete;
+    SwappableSearchServer& operator=(const SwappableSearchServer&) = delete;
+    // заменённые индексы, которые ещё держат запросы, освобождаются последним из них
+    ~SwappableSearchServer();
+
+    // публикует индекс, собранный заранее, например SearchServer::LoadIndex или OpenSnapshot
+    void Swap(SearchServer index);
+    // ждёт освобождения всех заменённых индексов и возвращает статистику последней подмены
+    IndexSwapStats WaitForReclaim();
+    // статистика последней подмены; всё, кроме swap_latency, заполняется после освобождения старого индекса
+    IndexSwapStats GetLastSwapStats() const;
+
+    // текущий индекс; пока указатель жив, индекс не освобождается
+    std::shared_ptr<const SearchServer> Acquire() const;
+
+    // принимает те же аргументы, что SearchServer::FindTopDocuments
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+
+    // найденные слова ссылаются на raw_query, а не на словарь индекса, который могут подменить
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+
+    size_t GetDocumentCount() const;
+
+private:
+    // метка заменённого индекса в retired_
+    struct SwapTag {
+        std::chrono::steady_clock::time_point retired_at;
+        uint64_t swap_number = 0;
+    };
+
+    template <typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocumentBy(const ExecutionPolicy& policy,
+        std::string_view raw_query, int document_id) const;
+
+    void ReclaimLoop();
+
+    // как часто фоновый поток проверяет, отпустили ли запросы заменённые индексы
+    static constexpr std::chrono::milliseconds RECLAIM_INTERVAL{ 10 };
+
+    // читается через atomic_load, меняется через atomic_store
+    std::shared_ptr<const SearchServer> current_;
+
+    mutable std::mutex mutex_;
+    RetiredList<SwapTag> retired_;
+    uint64_t swap_count_ = 0;
+    IndexSwapStats last_stats_;
+    // удалось ли сбросить пик resident size при последней подмене
+    bool peak_reset_ = false;
+    // фоновый поток освобождает индексы без блокировки
+    bool reclaiming_ = false;
+    std::condition_variable retired_added_;
+    std::condition_variable reclaimed_;
+    bool stopping_ = false;
+    std::thread reclaim_thread_;
+};
+
+template <typename... Args>
+std::vector<Document> SwappableSearchServer::FindTopDocuments(Args&&... args) const {
+    return Acquire()->FindTopDocuments(std::forward<Args>(args)...);
+}
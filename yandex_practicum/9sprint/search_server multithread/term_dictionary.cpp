@@ -0,0 +1,112 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+TermId TermDictionary::Intern(std::string_view term) {
+    const auto it = term_to_id_.find(term);
+    if (it != term_to_id_.end()) {
+        return it->second;
+    }
+    const std::string_view stored = Store(term);
+    TermId term_id;
+    if (free_ids_.empty()) {
+        term_id = static_cast<TermId>(id_to_term_.size());
+        id_to_term_.push_back(stored);
+    }
+    else {
+        term_id = free_ids_.back();
+        free_ids_.pop_back();
+        id_to_term_[term_id] = stored;
+    }
+    term_to_id_.emplace(stored, term_id);
+    return term_id;
+}
+
+TermId TermDictionary::Find(std::string_view term) const {
+    const auto it = term_to_id_.find(term);
+    return it == term_to_id_.end() ? NO_TERM : it->second;
+}
+
+std::string_view TermDictionary::GetTerm(TermId term_id) const {
+    return id_to_term_[term_id];
+}
+
+void TermDictionary::Remove(TermId term_id) {
+    const std::string_view term = id_to_term_[term_id];
+    term_to_id_.erase(term);
+    id_to_term_[term_id] = {};
+    free_ids_.push_back(term_id);
+    live_bytes_ -= term.size();
+    dead_bytes_ += term.size();
+    if (dead_bytes_ > live_bytes_ && dead_bytes_ > POOL_BLOCK_SIZE) {
+        RepackPool();
+    }
+}
+
+size_t TermDictionary::size() const {
+    return id_to_term_.size();
+}
+
+TermDictionary::SnapshotEntry TermDictionary::Save(SnapshotWriter& writer) const {
+    return { writer.WriteStrings(id_to_term_), writer.Write(free_ids_) };
+}
+
+void TermDictionary::Load(const SnapshotReader& reader, const SnapshotEntry& entry) {
+    id_to_term_ = reader.Strings(entry.terms);
+    const MappedArray<TermId> free_ids = reader.Array<TermId>(entry.free_ids);
+    free_ids_.assign(free_ids.begin(), free_ids.end());
+    pool_blocks_.clear();
+    pool_block_size_ = 0;
+    pool_block_used_ = 0;
+    live_bytes_ = 0;
+    dead_bytes_ = 0;
+    term_to_id_.clear();
+    term_to_id_.reserve(id_to_term_.size());
+    for (TermId term_id = 0; term_id < id_to_term_.size(); ++term_id) {
+        if (!id_to_term_[term_id].empty()) {
+            if (!term_to_id_.emplace(id_to_term_[term_id], term_id).second) {
+                throw std::runtime_error("Snapshot file is damaged");
+            }
+            live_bytes_ += id_to_term_[term_id].size();
+        }
+    }
+    // свободный номер достаётся новому слову, поэтому он должен быть в словаре, пустым и не повторяться
+    std::vector<bool> is_free(id_to_term_.size());
+    for (const TermId term_id : free_ids_) {
+        if (term_id >= id_to_term_.size() || !id_to_term_[term_id].empty() || is_free[term_id]) {
+            throw std::runtime_error("Snapshot file is damaged");
+        }
+        is_free[term_id] = true;
+    }
+}
+
+std::string_view TermDictionary::Store(std::string_view term) {
+    if (pool_block_used_ + term.size() > pool_block_size_) {
+        // слово длиннее блока получает отдельный блок по своему размеру
+        pool_block_size_ = std::max(POOL_BLOCK_SIZE, term.size());
+        pool_blocks_.push_back(std::make_unique<char[]>(pool_block_size_));
+        pool_block_used_ = 0;
+    }
+    char* data = pool_blocks_.back().get() + pool_block_used_;
+    std::memcpy(data, term.data(), term.size());
+    pool_block_used_ += term.size();
+    live_bytes_ += term.size();
+    return { data, term.size() };
+}
+
+void TermDictionary::RepackPool() {
+    const auto old_blocks = std::move(pool_blocks_);
+    pool_blocks_.clear();
+    pool_block_size_ = 0;
+    pool_block_used_ = 0;
+    live_bytes_ = 0;
+    dead_bytes_ = 0;
+    term_to_id_.clear();
+    for (TermId term_id = 0; term_id < id_to_term_.size(); ++term_id) {
+        if (!id_to_term_[term_id].empty()) {
+            id_to_term_[term_id] = Store(id_to_term_[term_id]);
+            term_to_id_.emplace(id_to_term_[term_id], term_id);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "snapshot_file.h"
+
+using TermId = uint32_t;
+
+// словарь слов индекса: каждому уникальному слову выдаётся плотный номер.
+// строки слов словарь хранит сам, копируя их в пул из больших блоков памяти; у словаря из снимка
+// строки остаются в страницах снимка, пока пул не уплотнится
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    // описание словаря в снимке индекса
+    struct SnapshotEntry {
+        SnapshotStrings terms;
+        SnapshotArray free_ids;
+    };
+
+    // возвращает номер слова, при необходимости заводя новый
+    TermId Intern(std::string_view term);
+    // возвращает номер слова или NO_TERM, если слова нет в словаре
+    TermId Find(std::string_view term) const;
+    // string_view действителен до удаления слова или уплотнения пула
+    std::string_view GetTerm(TermId term_id) const;
+    // удаляет слово, его номер достанется следующему новому слову. когда удалённых байт в пуле
+    // становится больше, чем занятых живыми словами, пул уплотняется
+    void Remove(TermId term_id);
+
+    // число выданных номеров вместе с освободившимися
+    size_t size() const;
+
+    SnapshotEntry Save(SnapshotWriter& writer) const;
+    // заменяет словарь сохранённым в снимке: строки слов остаются в страницах снимка,
+    // заново строится только хеш-таблица
+    void Load(const SnapshotReader& reader, const SnapshotEntry& entry);
+
+private:
+    static constexpr size_t POOL_BLOCK_SIZE = 64 * 1024;
+
+    // копирует строку в пул
+    std::string_view Store(std::string_view term);
+    // переносит живые слова в новый пул без промежутков
+    void RepackPool();
+
+    std::unordered_map<std::string_view, TermId> term_to_id_;
+    std::vector<std::string_view> id_to_term_;
+    std::vector<TermId> free_ids_;
+    std::vector<std::unique_ptr<char[]>> pool_blocks_;
+    size_t pool_block_size_ = 0;
+    size_t pool_block_used_ = 0;
+    size_t live_bytes_ = 0;
+    size_t dead_bytes_ = 0;
+};
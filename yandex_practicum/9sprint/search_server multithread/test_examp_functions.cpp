@@ -0,0 +1,845 @@
+#include "test_examp_functions.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "document.h"
+#include "durable_search_server.h"
+#include "external_index_builder.h"
+#include "posting_kernels.h"
+#include "process_memory.h"
+#include "search_server.h"
+#include "segmented_search_server.h"
+#include "swappable_search_server.h"
+#include "top_documents.h"
+#include "write_ahead_log.h"
+
+using namespace std;
+
+void AssertImpl(bool value, const string& expr_str, const string& file, const string& func, unsigned line,
+    const string& hint) {
+    if (!value) {
+        cerr << file << "("s << line << "): "s << func << ": "s;
+        cerr << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty()) {
+            cerr << " Hint: "s << hint;
+        }
+        cerr << endl;
+        abort();
+    }
+}
+
+namespace {
+
+const string STOP_WORDS = "and with"s;
+const RetrievalMode PRUNING_MODES[] = { RetrievalMode::MAX_SCORE, RetrievalMode::BLOCK_MAX, RetrievalMode::IMPACT };
+// страницы выдачи: count и offset
+const pair<size_t, size_t> PAGES[] = { { 5, 0 }, { 10, 3 }, { MAX_RESULT_DOCUMENT_COUNT, 0 }, { 50, 0 } };
+
+struct TestDocument {
+    int id;
+    string text;
+    DocumentStatus status;
+    vector<int> ratings;
+};
+
+// слово из словаря words_count слов: частые слова встречаются гораздо чаще редких, как в живых текстах
+string RandomWord(mt19937& generator, int words_count) {
+    const double u = uniform_real_distribution<>(0.0, 1.0)(generator);
+    return "w"s + to_string(static_cast<int>(pow(words_count, u)) - 1);
+}
+
+vector<TestDocument> MakeDocuments(mt19937& generator, int first_id, int count) {
+    vector<TestDocument> documents;
+    for (int id = first_id; id < first_id + count; ++id) {
+        string text;
+        const int length = 1 + generator() % 12;
+        for (int i = 0; i < length; ++i) {
+            text += generator() % 10 == 0 ? "and"s : RandomWord(generator, 300);
+            text += ' ';
+        }
+        const auto status = static_cast<DocumentStatus>(generator() % 8 == 0 ? 1 + generator() % 3 : 0);
+        documents.push_back({ id, text, status, { static_cast<int>(generator() % 10) - 3, static_cast<int>(generator() % 10) } });
+    }
+    return documents;
+}
+
+vector<NewDocument> ToNewDocuments(const vector<TestDocument>& documents) {
+    vector<NewDocument> result;
+    for (const TestDocument& document : documents) {
+        result.push_back({ document.id, document.text, document.status, document.ratings });
+    }
+    return result;
+}
+
+vector<string> MakeQueries(mt19937& generator, int count) {
+    vector<string> queries;
+    for (int i = 0; i < count; ++i) {
+        string query;
+        const int length = 1 + generator() % 5;
+        for (int j = 0; j < length; ++j) {
+            if (generator() % 6 == 0) {
+                query += '-';
+            }
+            query += RandomWord(generator, 320);
+            query += ' ';
+        }
+        queries.push_back(query);
+    }
+    return queries;
+}
+
+// релевантности и рейтинги совпадают по позициям; id сравниваются только у документов, чья релевантность
+// не совпадает с соседями и с краями страницы: порядок равных документов и то, какой из них попал на границу страницы,
+// не задан
+void AssertSameDocuments(const vector<Document>& expected, const vector<Document>& actual, const string& hint) {
+    ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_HINT(abs(actual[i].relevance - expected[i].relevance) < TopDocuments::EPSILON, hint);
+        ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, hint);
+        const bool tied_with_previous = i > 0 && expected[i - 1].relevance - expected[i].relevance < TopDocuments::EPSILON;
+        const bool tied_with_next = i + 1 < expected.size() && expected[i].relevance - expected[i + 1].relevance < TopDocuments::EPSILON;
+        const bool tied_with_first = expected.front().relevance - expected[i].relevance < TopDocuments::EPSILON;
+        const bool tied_with_last = expected[i].relevance - expected.back().relevance < TopDocuments::EPSILON;
+        if (!tied_with_previous && !tied_with_next && !tied_with_first && !tied_with_last) {
+            ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint);
+        }
+    }
+}
+
+void AssertSameMatch(const tuple<vector<string_view>, DocumentStatus>& expected, const tuple<vector<string_view>, DocumentStatus>& actual,
+    const string& hint) {
+    const auto& [expected_words, expected_status] = expected;
+    const auto& [actual_words, actual_status] = actual;
+    ASSERT_HINT(vector<string>(actual_words.begin(), actual_words.end()) == vector<string>(expected_words.begin(), expected_words.end()), hint);
+    ASSERT_HINT(actual_status == expected_status, hint);
+}
+
+bool IsSelectedDocument(int document_id, DocumentStatus status, int rating) {
+    return document_id % 3 != 0 && status != DocumentStatus::BANNED && rating >= 0;
+}
+
+// выдача ускоренных режимов против полного перебора того же сервера
+void CheckPruningModes(const SearchServer& server, const vector<string>& queries, const string& stage) {
+    for (const string& query : queries) {
+        for (const auto& [count, offset] : PAGES) {
+            const string hint = stage + " ["s + query + "] count "s + to_string(count) + " offset "s + to_string(offset);
+            const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, count, offset);
+            const auto expected_banned = server.FindTopDocuments(query, DocumentStatus::BANNED, count, offset);
+            const auto expected_filtered = server.FindTopDocuments(query, IsSelectedDocument, count, offset);
+            for (const RetrievalMode mode : PRUNING_MODES) {
+                const string mode_hint = hint + " mode "s + to_string(static_cast<int>(mode));
+                AssertSameDocuments(expected, server.FindTopDocuments(query, DocumentStatus::ACTUAL, count, offset, mode), mode_hint);
+                AssertSameDocuments(expected, server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, count, offset, mode), mode_hint);
+                AssertSameDocuments(expected_banned, server.FindTopDocuments(query, DocumentStatus::BANNED, count, offset, mode), mode_hint);
+                AssertSameDocuments(expected_filtered, server.FindTopDocuments(query, IsSelectedDocument, count, offset, mode), mode_hint);
+                AssertSameDocuments(expected_filtered, server.FindTopDocuments(execution::par, query, IsSelectedDocument, count, offset, mode),
+                    mode_hint);
+            }
+        }
+    }
+}
+
+
+// два сервера с одними документами отвечают одинаково во всех режимах
+template <typename Expected, typename Actual>
+void CheckSameResults(const Expected& expected, const Actual& actual, const vector<string>& queries, const string& stage) {
+    ASSERT_EQUAL_HINT(actual.GetDocumentCount(), expected.GetDocumentCount(), stage);
+    for (const string& query : queries) {
+        const string hint = stage + " ["s + query + "]"s;
+        AssertSameDocuments(expected.FindTopDocuments(query), actual.FindTopDocuments(query), hint);
+        AssertSameDocuments(expected.FindTopDocuments(query), actual.FindTopDocuments(execution::par, query), hint);
+        for (const RetrievalMode mode : PRUNING_MODES) {
+            AssertSameDocuments(expected.FindTopDocuments(query, DocumentStatus::ACTUAL, 10, 2),
+                actual.FindTopDocuments(query, DocumentStatus::ACTUAL, 10, 2, mode), hint);
+            AssertSameDocuments(expected.FindTopDocuments(query, IsSelectedDocument, 10),
+                actual.FindTopDocuments(query, IsSelectedDocument, 10, 0, mode), hint);
+        }
+    }
+}
+
+void CheckSameMatches(const SearchServer& expected, const SearchServer& actual, const vector<string>& queries, const string& stage) {
+    size_t query_index = 0;
+    for (const int document_id : expected) {
+        const string& query = queries[query_index++ % queries.size()];
+        AssertSameMatch(expected.MatchDocument(query, document_id), actual.MatchDocument(query, document_id), stage + " ["s + query + "]"s);
+    }
+}
+
+// CompareImpactRanking на свежем снимке вкладов: точная выдача та же, что у FindTopDocuments
+void CheckImpactRanking(const SearchServer& server, const vector<string>& queries, const string& stage) {
+    for (const string& query : queries) {
+        const ImpactDeviation deviation = server.CompareImpactRanking(query);
+        const string hint = stage + " ["s + query + "]"s;
+        ASSERT_EQUAL_HINT(deviation.top_count, server.FindTopDocuments(query).size(), hint);
+        ASSERT_HINT(deviation.top_overlap <= deviation.top_count, hint);
+        ASSERT_HINT(deviation.candidate_count >= deviation.top_count, hint);
+    }
+}
+
+void AssertStaleImpactIndex(const SearchServer& server, const string& query, const string& stage) {
+    try {
+        server.CompareImpactRanking(query);
+        ASSERT_HINT(false, stage + ": CompareImpactRanking must reject a stale impact index"s);
+    }
+    catch (const logic_error&) {
+    }
+}
+
+// GetDocumentText: у живого документа текст, если тексты хранятся, иначе пустая строка;
+// у удалённого и неизвестного id - out_of_range
+void CheckDocumentTexts(const SearchServer& keeping, const SearchServer& discarding, const vector<TestDocument>& documents,
+    const set<int>& removed_ids, const string& stage) {
+    for (const TestDocument& document : documents) {
+        const string hint = stage + " id "s + to_string(document.id);
+        if (removed_ids.count(document.id) == 0) {
+            ASSERT_EQUAL_HINT(keeping.GetDocumentText(document.id), document.text, hint);
+            ASSERT_HINT(discarding.GetDocumentText(document.id).empty(), hint);
+            continue;
+        }
+        for (const SearchServer* server : { &keeping, &discarding }) {
+            try {
+                server->GetDocumentText(document.id);
+                ASSERT_HINT(false, hint + ": removed document must have no text"s);
+            }
+            catch (const out_of_range&) {
+            }
+        }
+    }
+    for (const SearchServer* server : { &keeping, &discarding }) {
+        try {
+            server->GetDocumentText(-1);
+            ASSERT_HINT(false, stage + ": unknown document must have no text"s);
+        }
+        catch (const out_of_range&) {
+        }
+    }
+}
+
+// длины массивов для ядер: короче вектора, не кратные 4 и 8 и длиннее нескольких векторов
+const size_t KERNEL_LENGTHS[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 11, 12, 15, 16, 17, 23, 24, 31, 33, 63, 64, 65, 127, 128, 129, 1000 };
+
+// отсортированные разные числа с шагом от 1 до max_step
+vector<int> MakeSortedValues(mt19937& generator, size_t count, int first, int max_step) {
+    vector<int> values(count);
+    for (int& value : values) {
+        value = first;
+        first += 1 + static_cast<int>(generator() % max_step);
+    }
+    return values;
+}
+
+// отсортированные разные числа: примерно половина из values, остальные из того же диапазона
+vector<int> MakeOverlappingValues(mt19937& generator, const vector<int>& values, size_t count) {
+    const int first = values.empty() ? 0 : values.front() - 5;
+    const int last = values.empty() ? 100 : values.back() + 5;
+    vector<int> result;
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(!values.empty() && generator() % 2 == 0 ? values[generator() % values.size()]
+            : first + static_cast<int>(generator() % (last - first + 1)));
+    }
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+struct KernelInput {
+    vector<int> values;
+    vector<int> probes;
+    int first;
+    vector<uint32_t> gaps;
+    vector<int> removed;
+    vector<uint32_t> query_terms;
+    vector<uint32_t> document_terms;
+};
+
+struct KernelOutput {
+    vector<size_t> less_counts;
+    vector<int> ids;
+    vector<uint32_t> positions;
+    vector<uint32_t> matched;
+
+    bool operator==(const KernelOutput& other) const {
+        return less_counts == other.less_counts && ids == other.ids && positions == other.positions && matched == other.matched;
+    }
+};
+
+// выходные массивы ровно той длины, которую допускает контракт ядра, чтобы лишняя запись была заметна под санитайзером
+KernelOutput RunKernels(const KernelInput& input) {
+    KernelOutput output;
+    for (const int probe : input.probes) {
+        output.less_counts.push_back(CountLess(input.values.data(), input.values.size(), probe));
+    }
+    output.ids.resize(input.gaps.size() + 1);
+    PrefixSumGaps(input.first, input.gaps.data(), input.gaps.size(), output.ids.data());
+    output.positions.resize(input.values.size());
+    output.positions.resize(DifferencePositions(input.values.data(), input.values.size(), input.removed.data(), input.removed.size(),
+        output.positions.data()));
+    output.matched.resize(min(input.query_terms.size(), input.document_terms.size()));
+    output.matched.resize(IntersectSorted(input.query_terms.data(), input.query_terms.size(), input.document_terms.data(),
+        input.document_terms.size(), output.matched.data()));
+    return output;
+}
+
+} // namespace
+
+void TestPruningModesMatchExhaustive() {
+    for (const PostingLayout layout : { PostingLayout::PLAIN, PostingLayout::COMPRESSED }) {
+        mt19937 generator(1);
+        SearchServer server(STOP_WORDS, layout);
+        // больше одного блока списка на частые слова, чтобы BLOCK_MAX пропускал блоки
+        const vector<TestDocument> documents = MakeDocuments(generator, 0, 3000);
+        for (const TestDocument& document : documents) {
+            server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        const vector<string> queries = MakeQueries(generator, 150);
+        const string layout_name = layout == PostingLayout::PLAIN ? "plain"s : "compressed"s;
+        server.BuildImpactIndex();
+        CheckImpactRanking(server, queries, layout_name);
+        CheckPruningModes(server, queries, layout_name);
+
+        // удаляется около двух третей документов, чтобы Compact перенумеровал оставшиеся
+        for (int document_id = 0; document_id < 3000; document_id += 1 + generator() % 2) {
+            server.RemoveDocument(document_id);
+        }
+        // снимок вкладов устарел: IMPACT считается полным перебором, а сравнение с ним невозможно
+        AssertStaleImpactIndex(server, queries.front(), layout_name + " removed"s);
+        CheckPruningModes(server, queries, layout_name + " removed, stale impact index"s);
+        server.BuildImpactIndex();
+        CheckImpactRanking(server, queries, layout_name + " removed"s);
+        CheckPruningModes(server, queries, layout_name + " removed"s);
+
+        // Compact с перенумерацией документов тоже делает снимок вкладов устаревшим
+        server.Compact();
+        AssertStaleImpactIndex(server, queries.front(), layout_name + " compacted"s);
+        CheckPruningModes(server, queries, layout_name + " compacted, old impact index"s);
+        server.BuildImpactIndex();
+        CheckImpactRanking(server, queries, layout_name + " compacted"s);
+        CheckPruningModes(server, queries, layout_name + " compacted"s);
+    }
+}
+
+void TestImpactModeOnNearTies() {
+    // слово a<k> встречается примерно в 8000 + k документах, поэтому IDF соседних слов отличаются меньше,
+    // чем на шаг квантования. у документов из двух таких слов точные релевантности различаются на доли шага,
+    // и квантованные оценки могут стоять в обратном порядке: такие документы выдача должна пересчитать точно
+    const int base_freq = 8000;
+    const int word_count = 40;
+    SearchServer server(STOP_WORDS);
+    int document_id = 0;
+    for (int i = 0; i < base_freq + word_count; ++i) {
+        string text = "filler"s;
+        for (int word = 0; word < word_count; ++word) {
+            if (i < base_freq + word) {
+                text += " a"s + to_string(word);
+            }
+        }
+        server.AddDocument(document_id++, text, DocumentStatus::ACTUAL, { 1 });
+    }
+    for (int first = 0; first < word_count; ++first) {
+        for (int second = first + 1; second < word_count; ++second) {
+            server.AddDocument(document_id++, "a"s + to_string(first) + " a"s + to_string(second), DocumentStatus::ACTUAL, { 1 });
+        }
+    }
+    // редкое слово с единственным вхождением задаёт самый большой вклад, а с ним и шаг
+    server.AddDocument(document_id++, "rare"s, DocumentStatus::ACTUAL, { 1 });
+    server.BuildImpactIndex();
+
+    mt19937 generator(6);
+    for (int i = 0; i < 2000; ++i) {
+        string query;
+        for (int word = 0; word < 4; ++word) {
+            query += "a"s + to_string(generator() % word_count) + " "s;
+        }
+        for (const size_t count : { 1, 2, 3 }) {
+            const string hint = "["s + query + "] count "s + to_string(count);
+            const auto expected = server.FindTopDocuments(query, DocumentStatus::ACTUAL, count);
+            AssertSameDocuments(expected, server.FindTopDocuments(query, DocumentStatus::ACTUAL, count, 0, RetrievalMode::IMPACT), hint);
+            AssertSameDocuments(expected, server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, count, 0, RetrievalMode::IMPACT),
+                hint);
+        }
+    }
+}
+
+void TestBatchRemoveMatchesRebuild() {
+    mt19937 generator(7);
+    const vector<TestDocument> documents = MakeDocuments(generator, 0, 2000);
+    const vector<string> queries = MakeQueries(generator, 100);
+    // во втором пакете есть и уже удалённые id; повторы и неизвестные id пропускаются
+    vector<vector<int>> batches(2);
+    for (vector<int>& batch : batches) {
+        for (int i = 0; i < 600; ++i) {
+            batch.push_back(generator() % 2000);
+        }
+        batch.push_back(batch.front());
+        batch.push_back(5000);
+        batch.push_back(-1);
+    }
+    batches.back().insert(batches.back().end(), batches.front().begin(), batches.front().begin() + 100);
+    const string overload_names[] = { "default"s, "seq"s, "par"s };
+
+    for (const PostingLayout layout : { PostingLayout::PLAIN, PostingLayout::COMPRESSED }) {
+        for (int overload = 0; overload < 3; ++overload) {
+            SearchServer server(STOP_WORDS, layout);
+            for (const TestDocument& document : documents) {
+                server.AddDocument(document.id, document.text, document.status, document.ratings);
+            }
+            set<int> removed_ids;
+            for (const vector<int>& batch : batches) {
+                if (overload == 0) {
+                    server.RemoveDocuments(batch);
+                }
+                else if (overload == 1) {
+                    server.RemoveDocuments(execution::seq, batch);
+                }
+                else {
+                    server.RemoveDocuments(execution::par, batch);
+                }
+                removed_ids.insert(batch.begin(), batch.end());
+                // сервер, в который удалённые документы не добавлялись
+                SearchServer rebuilt(STOP_WORDS, layout);
+                for (const TestDocument& document : documents) {
+                    if (removed_ids.count(document.id) == 0) {
+                        rebuilt.AddDocument(document.id, document.text, document.status, document.ratings);
+                    }
+                }
+                const string stage = overload_names[overload] + " batch "s + to_string(removed_ids.size());
+                CheckSameResults(rebuilt, server, queries, stage);
+                CheckSameMatches(rebuilt, server, queries, stage);
+                ASSERT_HINT(equal(server.begin(), server.end(), rebuilt.begin(), rebuilt.end()), stage);
+            }
+        }
+    }
+}
+
+void TestDocumentTextStorage() {
+    for (const PostingLayout layout : { PostingLayout::PLAIN, PostingLayout::COMPRESSED }) {
+        mt19937 generator(8);
+        const vector<TestDocument> documents = MakeDocuments(generator, 0, 2000);
+        SearchServer keeping(STOP_WORDS, layout, DocumentTextStorage::KEEP);
+        SearchServer discarding(STOP_WORDS, layout, DocumentTextStorage::DISCARD);
+        for (const TestDocument& document : documents) {
+            keeping.AddDocument(document.id, document.text, document.status, document.ratings);
+            discarding.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        set<int> removed_ids;
+        CheckDocumentTexts(keeping, discarding, documents, removed_ids, "added"s);
+        // удаляется больше половины документов, чтобы Compact перенумеровал оставшиеся и сжал столбец текстов
+        for (int document_id = 0; document_id < 2000; document_id += 1 + generator() % 2) {
+            keeping.RemoveDocument(document_id);
+            discarding.RemoveDocument(document_id);
+            removed_ids.insert(document_id);
+        }
+        CheckDocumentTexts(keeping, discarding, documents, removed_ids, "removed"s);
+        keeping.Compact();
+        discarding.Compact();
+        CheckDocumentTexts(keeping, discarding, documents, removed_ids, "compacted"s);
+    }
+}
+
+void TestPostingKernelsMatchScalar() {
+    const SimdLevel detected_level = GetSimdLevel();
+    mt19937 generator(5);
+    for (const size_t length : KERNEL_LENGTHS) {
+        for (int trial = 0; trial < 20; ++trial) {
+            KernelInput input;
+            // плотные и разреженные списки, в том числе с отрицательными числами
+            input.values = MakeSortedValues(generator, length, static_cast<int>(generator() % 1000) - 500, 1 + trial % 4 * 20);
+            // каждый элемент, его соседи и числа за краями: ответ попадает в каждую позицию окна NarrowToWindow
+            input.probes = { numeric_limits<int>::min(), numeric_limits<int>::max() };
+            for (const int value : input.values) {
+                input.probes.insert(input.probes.end(), { value - 1, value, value + 1 });
+            }
+            input.first = static_cast<int>(generator() % 1000);
+            for (size_t i = 0; i < length; ++i) {
+                input.gaps.push_back(generator() % 40);
+            }
+            input.removed = MakeOverlappingValues(generator, input.values, KERNEL_LENGTHS[generator() % size(KERNEL_LENGTHS)]);
+            const vector<int> document_terms = MakeSortedValues(generator, length, 0, 1 + trial % 4 * 20);
+            input.document_terms.assign(document_terms.begin(), document_terms.end());
+            const vector<int> query_terms = MakeOverlappingValues(generator, document_terms, 1 + generator() % 12);
+            input.query_terms.assign(query_terms.begin(), query_terms.end());
+
+            SetSimdLevel(SimdLevel::SCALAR);
+            const KernelOutput expected = RunKernels(input);
+            for (const SimdLevel level : { SimdLevel::SSE4, SimdLevel::AVX2 }) {
+                SetSimdLevel(level);
+                if (GetSimdLevel() != level) {
+                    continue;
+                }
+                ASSERT_HINT(RunKernels(input) == expected,
+                    "level "s + to_string(static_cast<int>(level)) + " length "s + to_string(length) + " trial "s + to_string(trial));
+            }
+        }
+    }
+    SetSimdLevel(detected_level);
+}
+
+void TestBatchAddMatchesSingleAdds() {
+    mt19937 generator(2);
+    const vector<TestDocument> documents = MakeDocuments(generator, 0, 2000);
+    const vector<NewDocument> batch = ToNewDocuments(documents);
+    const vector<string> queries = MakeQueries(generator, 100);
+    for (const PostingLayout layout : { PostingLayout::PLAIN, PostingLayout::COMPRESSED }) {
+        SearchServer single(STOP_WORDS, layout);
+        for (const TestDocument& document : documents) {
+            single.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        SearchServer sequential(STOP_WORDS, layout);
+        sequential.AddDocuments(execution::seq, batch);
+        SearchServer parallel(STOP_WORDS, layout);
+        // несколько пакетов подряд: второй и следующие дописываются к непустому индексу
+        for (size_t first = 0; first < batch.size(); first += 700) {
+            parallel.AddDocuments(execution::par, vector<NewDocument>(batch.begin() + first, batch.begin() + min(batch.size(), first + 700)));
+        }
+        CheckSameResults(single, sequential, queries, "seq batch"s);
+        CheckSameResults(single, parallel, queries, "par batch"s);
+        CheckSameMatches(single, parallel, queries, "par batch"s);
+
+        // пакет с уже добавленным id отвергается целиком
+        try {
+            parallel.AddDocuments(execution::par, { { 5000, "w1"sv, DocumentStatus::ACTUAL, { 1 } }, { 7, "w2"sv, DocumentStatus::ACTUAL, { 1 } } });
+            ASSERT_HINT(false, "batch with an existing id must be rejected"s);
+        }
+        catch (const invalid_argument&) {
+        }
+        ASSERT_EQUAL(parallel.GetDocumentCount(), single.GetDocumentCount());
+    }
+}
+
+void TestExternalIndexMatchesInMemory() {
+    const string path = (filesystem::temp_directory_path() / "test_examp_index.bin"s).string();
+    const string damaged_path = path + ".damaged"s;
+    mt19937 generator(9);
+    const vector<TestDocument> documents = MakeDocuments(generator, 0, 2000);
+    const vector<string> queries = MakeQueries(generator, 100);
+    {
+        // бюджета хватает на несколько сотен вхождений, поэтому прогонов несколько
+        ExternalIndexBuilder builder(STOP_WORDS, path, 8 << 10);
+        for (const TestDocument& document : documents) {
+            builder.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        builder.Finish();
+        ASSERT(builder.GetRunCount() > 1);
+        ASSERT_EQUAL(builder.GetDocumentCount(), documents.size());
+    }
+    for (const PostingLayout layout : { PostingLayout::PLAIN, PostingLayout::COMPRESSED }) {
+        SearchServer expected(STOP_WORDS, layout);
+        for (const TestDocument& document : documents) {
+            expected.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        const SearchServer loaded = SearchServer::LoadIndex(path, layout);
+        const string stage = layout == PostingLayout::PLAIN ? "plain index file"s : "compressed index file"s;
+        CheckSameResults(expected, loaded, queries, stage);
+        CheckSameMatches(expected, loaded, queries, stage);
+    }
+
+    string contents;
+    {
+        ifstream in(path, ios::binary);
+        contents.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    const auto assert_damaged = [&](const string& damaged, const string& hint) {
+        {
+            ofstream out(damaged_path, ios::binary);
+            out.write(damaged.data(), damaged.size());
+        }
+        try {
+            SearchServer::LoadIndex(damaged_path);
+            ASSERT_HINT(false, hint + ": damaged index file must be rejected"s);
+        }
+        catch (const runtime_error&) {
+        }
+    };
+    for (const size_t size : { size_t{ 0 }, size_t{ 4 }, size_t{ 20 }, contents.size() / 2, contents.size() - 1 }) {
+        assert_damaged(contents.substr(0, size), "truncated to "s + to_string(size));
+    }
+    // старшие байты чисел: заголовок, число слов словаря после стоп-слов "and" и "with",
+    // номер слова, номер документа и число вхождений в последней записи вхождений
+    const size_t term_count_offset = 2 * sizeof(uint32_t) + sizeof(uint64_t) + (sizeof(uint64_t) + 3) + (sizeof(uint64_t) + 4);
+    const size_t last_occurrence_offset = contents.size() - sizeof(IndexFileOccurrence);
+    for (const size_t offset : { size_t{ 0 }, term_count_offset + 7, last_occurrence_offset + 3, last_occurrence_offset + 7,
+             last_occurrence_offset + 11 }) {
+        string damaged = contents;
+        damaged[offset] = static_cast<char>(damaged[offset] ^ 0x80);
+        assert_damaged(damaged, "byte "s + to_string(offset) + " flipped"s);
+    }
+    filesystem::remove(path);
+    filesystem::remove(damaged_path);
+}
+
+void TestSnapshotMatchesIndex() {
+    const string path = (filesystem::temp_directory_path() / "test_examp_snapshot.bin"s).string();
+    for (const PostingLayout layout : { PostingLayout::PLAIN, PostingLayout::COMPRESSED }) {
+        mt19937 generator(3);
+        SearchServer server(STOP_WORDS, layout);
+        server.AddDocuments(ToNewDocuments(MakeDocuments(generator, 0, 2000)));
+        for (int document_id = 0; document_id < 2000; document_id += 5) {
+            server.RemoveDocument(document_id);
+        }
+        server.SaveSnapshot(path);
+        const SearchServer opened = SearchServer::OpenSnapshot(path);
+        const vector<string> queries = MakeQueries(generator, 100);
+        CheckSameResults(server, opened, queries, "snapshot"s);
+        CheckSameMatches(server, opened, queries, "snapshot"s);
+    }
+    // обрезанный снимок не открывается
+    const uintmax_t size = filesystem::file_size(path);
+    filesystem::resize_file(path, size / 2);
+    try {
+        SearchServer::OpenSnapshot(path);
+        ASSERT_HINT(false, "truncated snapshot must be rejected"s);
+    }
+    catch (const runtime_error&) {
+    }
+    filesystem::remove(path);
+}
+
+void TestDurableRecovery() {
+    const filesystem::path directory = filesystem::temp_directory_path() / "test_examp_durable"s;
+    const string log_path = (directory / "wal.1"s).string();
+    const auto count_records = [&]() {
+        WalReader reader(log_path);
+        WalRecord record;
+        size_t count = 0;
+        while (reader.Next(record)) {
+            ++count;
+        }
+        return pair{ count, reader.GetValidSize() };
+    };
+    for (const WalSyncPolicy policy : { WalSyncPolicy::ALWAYS, WalSyncPolicy::PERIODIC }) {
+        const string stage = policy == WalSyncPolicy::ALWAYS ? "ALWAYS"s : "PERIODIC"s;
+        filesystem::remove_all(directory);
+        DurabilityOptions options;
+        options.sync_policy = policy;
+        options.sync_interval = 5ms;
+        mt19937 generator(6);
+        const vector<string> queries = MakeQueries(generator, 60);
+        SearchServer reference(STOP_WORDS);
+        int next_id = 0;
+        // подряд идущие добавления при повторе журнала сливаются в один пакет
+        const auto add_one_by_one = [&](DurableSearchServer& durable, int count) {
+            for (const TestDocument& document : MakeDocuments(generator, next_id, count)) {
+                reference.AddDocument(document.id, document.text, document.status, document.ratings);
+                durable.AddDocument(document.id, document.text, document.status, document.ratings);
+            }
+            next_id += count;
+        };
+        const auto add_batch = [&](DurableSearchServer& durable, int count) {
+            const vector<TestDocument> documents = MakeDocuments(generator, next_id, count);
+            reference.AddDocuments(ToNewDocuments(documents));
+            durable.AddDocuments(ToNewDocuments(documents));
+            next_id += count;
+        };
+        const auto remove = [&](DurableSearchServer& durable, int first_id, int last_id, int step) {
+            vector<int> document_ids;
+            for (int document_id = first_id; document_id < last_id; document_id += step) {
+                document_ids.push_back(document_id);
+            }
+            reference.RemoveDocuments(document_ids);
+            durable.RemoveDocuments(document_ids);
+        };
+        const auto check = [&](const DurableSearchServer& durable, const string& hint) {
+            CheckSameResults(reference, durable.GetServer(), queries, stage + " "s + hint);
+            CheckSameMatches(reference, durable.GetServer(), queries, stage + " "s + hint);
+        };
+
+        vector<int> last_batch_ids;
+        {
+            DurableSearchServer durable(directory.string(), STOP_WORDS, options);
+            add_one_by_one(durable, 300);
+            add_batch(durable, 200);
+            for (int document_id = 0; document_id < 500; document_id += 7) {
+                reference.RemoveDocument(document_id);
+                durable.RemoveDocument(document_id);
+            }
+            remove(durable, 1, 500, 11);
+            durable.Checkpoint();
+            ASSERT(filesystem::exists(directory / "snapshot.1"s));
+            ASSERT(filesystem::exists(log_path));
+            ASSERT(!filesystem::exists(directory / "wal.0"s));
+
+            add_one_by_one(durable, 200);
+            remove(durable, 500, 700, 9);
+            add_one_by_one(durable, 50);
+            add_batch(durable, 3);
+            for (int document_id = next_id - 3; document_id < next_id; ++document_id) {
+                last_batch_ids.push_back(document_id);
+            }
+            if (policy == WalSyncPolicy::PERIODIC) {
+                // фоновый поток успевает сбросить журнал по таймеру
+                this_thread::sleep_for(20ms);
+            }
+        }
+        {
+            DurableSearchServer reopened(directory.string(), STOP_WORDS, options);
+            check(reopened, "reopened"s);
+        }
+
+        // оторванный хвост: теряется только последняя запись, а конструктор отрезает её остаток
+        const auto [record_count, log_size] = count_records();
+        ASSERT_EQUAL(log_size, filesystem::file_size(log_path));
+        filesystem::resize_file(log_path, log_size - 5);
+        const auto [torn_record_count, valid_size] = count_records();
+        ASSERT_EQUAL(torn_record_count, record_count - 1);
+        ASSERT(valid_size < log_size - 5);
+        reference.RemoveDocuments(last_batch_ids);
+        {
+            DurableSearchServer reopened(directory.string(), STOP_WORDS, options);
+            ASSERT_EQUAL(filesystem::file_size(log_path), valid_size);
+            check(reopened, "torn tail"s);
+            add_one_by_one(reopened, 1);
+        }
+        {
+            DurableSearchServer reopened(directory.string(), STOP_WORDS, options);
+            check(reopened, "after torn tail"s);
+        }
+    }
+    filesystem::remove_all(directory);
+}
+
+void TestSegmentedMatchesSearchServer() {
+    mt19937 generator(4);
+    SegmentOptions options;
+    // маленький изменяемый сегмент, чтобы за тест прошли и запечатывание, и слияния нескольких ярусов
+    options.memtable_size = 64;
+    options.merge_factor = 3;
+    SearchServer reference(STOP_WORDS);
+    SegmentedSearchServer segmented(STOP_WORDS, options);
+    const vector<string> queries = MakeQueries(generator, 40);
+    set<int> live_ids;
+    int next_id = 0;
+    const auto check = [&](const string& stage) {
+        CheckSameResults(reference, segmented, queries, stage);
+        size_t query_index = 0;
+        for (const int document_id : reference) {
+            const string& query = queries[query_index++ % queries.size()];
+            AssertSameMatch(reference.MatchDocument(query, document_id), segmented.MatchDocument(query, document_id), stage);
+        }
+    };
+    for (int step = 0; step < 3000; ++step) {
+        const unsigned kind = generator() % 100;
+        if (kind < 60) {
+            const TestDocument document = MakeDocuments(generator, next_id++, 1).front();
+            reference.AddDocument(document.id, document.text, document.status, document.ratings);
+            segmented.AddDocument(document.id, document.text, document.status, document.ratings);
+            live_ids.insert(document.id);
+        }
+        else if (kind < 65) {
+            // пакеты меньше и больше изменяемого сегмента
+            const vector<TestDocument> documents = MakeDocuments(generator, next_id, generator() % 2 == 0 ? 10 : 100);
+            next_id += static_cast<int>(documents.size());
+            reference.AddDocuments(ToNewDocuments(documents));
+            segmented.AddDocuments(execution::par, ToNewDocuments(documents));
+            for (const TestDocument& document : documents) {
+                live_ids.insert(document.id);
+            }
+        }
+        else if (kind < 95) {
+            if (live_ids.empty()) {
+                continue;
+            }
+            const int document_id = *next(live_ids.begin(), generator() % live_ids.size());
+            reference.RemoveDocument(document_id);
+            segmented.RemoveDocument(document_id);
+            live_ids.erase(document_id);
+        }
+        else if (kind < 97) {
+            // пакет удалений задевает документы разных сегментов
+            vector<int> document_ids;
+            for (int i = 0; i < 20 && !live_ids.empty(); ++i) {
+                const int document_id = *next(live_ids.begin(), generator() % live_ids.size());
+                document_ids.push_back(document_id);
+                live_ids.erase(document_id);
+            }
+            reference.RemoveDocuments(document_ids);
+            segmented.RemoveDocuments(document_ids);
+        }
+        else if (kind < 99) {
+            segmented.Flush();
+        }
+        else {
+            segmented.WaitForMerges();
+        }
+        if (step % 300 == 299) {
+            check("segmented step "s + to_string(step));
+        }
+    }
+    segmented.Flush();
+    segmented.WaitForMerges();
+    check("segmented merged"s);
+}
+
+void TestSwappableKeepsOldIndexForReaders() {
+    // пик отслеживается, только если ядро даёт его сбросить
+    const bool peak_available = ResetPeakResidentBytes();
+    mt19937 generator(8);
+    const vector<TestDocument> old_documents = MakeDocuments(generator, 0, 500);
+    const vector<TestDocument> new_documents = MakeDocuments(generator, 1000, 300);
+    const vector<string> queries = MakeQueries(generator, 60);
+    SearchServer expected_old(STOP_WORDS);
+    expected_old.AddDocuments(ToNewDocuments(old_documents));
+    SearchServer expected_new(STOP_WORDS);
+    expected_new.AddDocuments(ToNewDocuments(new_documents));
+
+    SearchServer old_index(STOP_WORDS);
+    old_index.AddDocuments(ToNewDocuments(old_documents));
+    SwappableSearchServer swappable(move(old_index));
+    shared_ptr<const SearchServer> held = swappable.Acquire();
+    SearchServer new_index(STOP_WORDS);
+    new_index.AddDocuments(ToNewDocuments(new_documents));
+    swappable.Swap(move(new_index));
+
+    // взятый до подмены индекс жив и отвечает по-старому, новые запросы идут в новый индекс
+    CheckSameResults(expected_old, *held, queries, "held index"s);
+    CheckSameMatches(expected_old, *held, queries, "held index"s);
+    CheckSameResults(expected_new, swappable, queries, "swapped index"s);
+
+    // WaitForReclaim ждёт, пока старый индекс держат
+    atomic<bool> reclaimed = false;
+    IndexSwapStats stats;
+    thread waiter([&]() {
+        stats = swappable.WaitForReclaim();
+        reclaimed = true;
+        });
+    this_thread::sleep_for(50ms);
+    ASSERT(!reclaimed);
+    held.reset();
+    waiter.join();
+    ASSERT(stats.drain_time >= 50ms);
+    ASSERT_EQUAL(swappable.GetLastSwapStats().drain_time.count(), stats.drain_time.count());
+    if (GetResidentBytes() > 0) {
+        ASSERT(stats.resident_bytes_after > 0);
+    }
+    // пик снимается, пока в памяти оба индекса
+    if (peak_available) {
+        ASSERT(stats.peak_resident_bytes > 0);
+    }
+}
+
+void TestSearchServer() {
+    RUN_TEST(TestPruningModesMatchExhaustive);
+    RUN_TEST(TestImpactModeOnNearTies);
+    RUN_TEST(TestBatchRemoveMatchesRebuild);
+    RUN_TEST(TestDocumentTextStorage);
+    RUN_TEST(TestPostingKernelsMatchScalar);
+    RUN_TEST(TestBatchAddMatchesSingleAdds);
+    RUN_TEST(TestExternalIndexMatchesInMemory);
+    RUN_TEST(TestSnapshotMatchesIndex);
+    RUN_TEST(TestDurableRecovery);
+    RUN_TEST(TestSegmentedMatchesSearchServer);
+    RUN_TEST(TestSwappableKeepsOldIndexForReaders);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+// -------- макросы проверок для юнит-тестов поисковой системы ----------
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std::string& u_str, const std::string& file,
+    const std::string& func, unsigned line, const std::string& hint) {
+    using namespace std;
+    if (t != u) {
+        cerr << boolalpha;
+        cerr << file << "("s << line << "): "s << func << ": "s;
+        cerr << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
+        cerr << t << " != "s << u << "."s;
+        if (!hint.empty()) {
+            cerr << " Hint: "s << hint;
+        }
+        cerr << endl;
+        abort();
+    }
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
+    const std::string& hint);
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+// -------- дифференциальные тесты: ускоренные пути сравниваются с полным перебором ----------
+
+// MAX_SCORE, BLOCK_MAX и IMPACT возвращают ту же выдачу, что и EXHAUSTIVE, в обоих форматах списков,
+// со статусом и предикатом, со страницами выдачи, последовательно и параллельно, до и после удалений и Compact.
+// IMPACT проверяется и на свежем, и на устаревшем снимке вкладов
+void TestPruningModesMatchExhaustive();
+// IMPACT находит точную выдачу, даже когда округление вкладов переставляет документы с почти равной релевантностью
+void TestImpactModeOnNearTies();
+// RemoveDocuments во всех перегрузках, с повторами и неизвестными id, даёт ту же выдачу,
+// что сервер, в который удалённые документы не добавлялись
+void TestBatchRemoveMatchesRebuild();
+// GetDocumentText возвращает текст при DocumentTextStorage::KEEP и пустую строку при DISCARD,
+// в том числе после Compact; для удалённого и неизвестного id бросает out_of_range
+void TestDocumentTextStorage();
+// версии SSE4.1 и AVX2 ядер posting_kernels.h дают то же, что скалярные, на массивах любой длины
+void TestPostingKernelsMatchScalar();
+// AddDocuments пакетом и AddDocument по одному дают одну и ту же выдачу
+void TestBatchAddMatchesSingleAdds();
+// индекс, собранный ExternalIndexBuilder в несколько прогонов и загруженный LoadIndex в любом формате списков,
+// отвечает так же, как собранный в памяти; обрезанный и испорченный файл LoadIndex отвергает
+void TestExternalIndexMatchesInMemory();
+// индекс, открытый из снимка, отвечает так же, как сохранённый; обрезанный снимок не открывается
+void TestSnapshotMatchesIndex();
+// DurableSearchServer при ALWAYS и PERIODIC восстанавливает после переоткрытия каталога добавления, пакеты
+// и удаления до и после Checkpoint; при оторванном хвосте журнала теряется только последняя запись
+void TestDurableRecovery();
+// SegmentedSearchServer отвечает так же, как SearchServer с теми же документами, пока идут добавления,
+// удаления по одному и пакетами, запечатывание изменяемых сегментов и слияния
+void TestSegmentedMatchesSearchServer();
+// индекс, взятый через Acquire до Swap, отвечает по-старому, пока его держат; WaitForReclaim возвращается
+// только после того, как его отпустят, и заполняет статистику подмены
+void TestSwappableKeepsOldIndexForReaders();
+
+template <typename TFunc>
+void RunTestImpl(TFunc& testFunc, const std::string& func_name) {
+    testFunc();
+    std::cerr << func_name << " OK" << std::endl;
+}
+#define RUN_TEST(func)  RunTestImpl((func), (#func))
+
+void TestSearchServer();
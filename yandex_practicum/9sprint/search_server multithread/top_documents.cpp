@@ -0,0 +1,43 @@
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+TopDocuments::TopDocuments(size_t capacity)
+    : capacity_(capacity) {
+}
+
+void TopDocuments::Push(const Document& document) {
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsBetter);
+    }
+    else if (capacity_ > 0 && IsBetter(document, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), IsBetter);
+        heap_.back() = document;
+        std::push_heap(heap_.begin(), heap_.end(), IsBetter);
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments& other) {
+    for (const Document& document : other.heap_) {
+        Push(document);
+    }
+}
+
+std::vector<Document> TopDocuments::Extract(size_t offset) {
+    std::sort_heap(heap_.begin(), heap_.end(), IsBetter);
+    heap_.erase(heap_.begin(), heap_.begin() + std::min(offset, heap_.size()));
+    return std::move(heap_);
+}
+
+size_t TopDocuments::PageDepth(size_t count, size_t offset) {
+    return count > SIZE_MAX - offset ? SIZE_MAX : offset + count;
+}
+
+bool TopDocuments::IsBetter(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
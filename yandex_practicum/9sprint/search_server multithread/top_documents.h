@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "document.h"
+
+// отбирает не больше capacity лучших документов с помощью ограниченной кучи,
+// порядок тот же, что и при сортировке результатов: релевантность, затем рейтинг
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity);
+
+    void Push(const Document& document);
+    // добавляет документы, отобранные другим экземпляром
+    void Merge(const TopDocuments& other);
+    // возвращает отобранные документы от лучшего к худшему, пропустив первые offset
+    std::vector<Document> Extract(size_t offset = 0);
+
+    // сколько лучших документов нужно отобрать для страницы выдачи
+    static size_t PageDepth(size_t count, size_t offset);
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+    bool IsFull() const {
+        return heap_.size() >= capacity_;
+    }
+    // релевантность худшего из отобранных документов, куча не должна быть пустой
+    double WorstRelevance() const {
+        return heap_.front().relevance;
+    }
+
+    // релевантности, отличающиеся меньше чем на EPSILON, считаются равными
+    static constexpr double EPSILON = 1e-6;
+
+    // true если lhs должен стоять в выдаче раньше rhs
+    static bool IsBetter(const Document& lhs, const Document& rhs);
+
+private:
+    size_t capacity_;
+    std::vector<Document> heap_; // на вершине худший из отобранных документов
+};
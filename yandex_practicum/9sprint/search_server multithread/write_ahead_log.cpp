@@ -0,0 +1,355 @@
+#include "write_ahead_log.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// заголовок записи: размер тела и его CRC32
+struct WalRecordHeader {
+    uint32_t size;
+    uint32_t checksum;
+};
+
+constexpr array<uint32_t, 256> MakeCrcTable() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr array<uint32_t, 256> CRC_TABLE = MakeCrcTable();
+
+uint32_t ComputeCrc(string_view data) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (const char c : data) {
+        crc = CRC_TABLE[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+template <typename T>
+void Put(string& body, const T& value) {
+    body.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// разбирает тело записи, контрольная сумма которого уже сошлась
+class BodyReader {
+public:
+    explicit BodyReader(string_view body)
+        : body_(body) {
+    }
+
+    template <typename T>
+    T Get() {
+        T value;
+        memcpy(&value, Take(sizeof(value)).data(), sizeof(value));
+        return value;
+    }
+    string_view Take(size_t size) {
+        if (size > body_.size()) {
+            throw runtime_error("Write-ahead log is damaged"s);
+        }
+        const string_view result = body_.substr(0, size);
+        body_.remove_prefix(size);
+        return result;
+    }
+    bool AtEnd() const {
+        return body_.empty();
+    }
+
+private:
+    string_view body_;
+};
+
+WalRecord ParseRecord(string_view body) {
+    BodyReader reader(body);
+    WalRecord record;
+    record.type = static_cast<WalRecordType>(reader.Get<uint8_t>());
+    const uint64_t count = reader.Get<uint64_t>();
+    if (record.type == WalRecordType::ADD_DOCUMENTS) {
+        for (uint64_t i = 0; i < count; ++i) {
+            WalDocument document;
+            document.id = reader.Get<int32_t>();
+            document.status = static_cast<DocumentStatus>(reader.Get<int32_t>());
+            document.ratings.resize(reader.Get<uint64_t>());
+            for (int& rating : document.ratings) {
+                rating = reader.Get<int32_t>();
+            }
+            document.text = reader.Take(reader.Get<uint64_t>());
+            record.documents.push_back(move(document));
+        }
+    } else if (record.type == WalRecordType::REMOVE_DOCUMENT || record.type == WalRecordType::REMOVE_DOCUMENTS) {
+        for (uint64_t i = 0; i < count; ++i) {
+            record.document_ids.push_back(reader.Get<int32_t>());
+        }
+    } else {
+        throw runtime_error("Write-ahead log is damaged"s);
+    }
+    if (!reader.AtEnd() || (record.type == WalRecordType::REMOVE_DOCUMENT && record.document_ids.size() != 1)) {
+        throw runtime_error("Write-ahead log is damaged"s);
+    }
+    return record;
+}
+
+void WriteAll(int fd, string_view data, const string& path) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("Cannot write "s + path);
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+} // namespace
+
+WalReader::WalReader(const string& path)
+    : in_(path, ios::binary) {
+    in_.seekg(0, ios::end);
+    file_size_ = in_ ? static_cast<uint64_t>(in_.tellg()) : 0;
+    in_.seekg(0);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    in_.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in_.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!in_) {
+        // журнал не создан или не дописан даже заголовок
+        at_end_ = true;
+        return;
+    }
+    if (magic != WAL_FILE_MAGIC || version != WAL_FILE_VERSION) {
+        throw runtime_error("Unsupported write-ahead log "s + path);
+    }
+    valid_size_ = sizeof(magic) + sizeof(version);
+}
+
+bool WalReader::Next(WalRecord& record) {
+    if (at_end_) {
+        return false;
+    }
+    WalRecordHeader header;
+    string body;
+    // размер из недописанного заголовка может быть любым, поэтому он сверяется с остатком файла
+    if (in_.read(reinterpret_cast<char*>(&header), sizeof(header))
+        && header.size <= file_size_ - valid_size_ - sizeof(header)) {
+        body.resize(header.size);
+        in_.read(body.data(), body.size());
+    }
+    if (!in_ || ComputeCrc(body) != header.checksum) {
+        at_end_ = true;
+        return false;
+    }
+    record = ParseRecord(body);
+    valid_size_ += sizeof(header) + body.size();
+    return true;
+}
+
+uint64_t WalReader::GetValidSize() const {
+    return valid_size_;
+}
+
+WriteAheadLog::WriteAheadLog(string path, WalSyncPolicy sync_policy, chrono::milliseconds sync_interval)
+    : path_(move(path))
+    , sync_policy_(sync_policy)
+    , sync_interval_(sync_interval) {
+    uint64_t valid_size = 0;
+    {
+        WalReader reader(path_);
+        WalRecord record;
+        while (reader.Next(record)) {
+        }
+        valid_size = reader.GetValidSize();
+    }
+    fd_ = open(path_.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd_ < 0) {
+        throw runtime_error("Cannot open "s + path_);
+    }
+    // следующие записи должны идти сразу за последней целой, иначе чтение остановится на старом хвосте
+    if (ftruncate(fd_, static_cast<off_t>(valid_size)) != 0 || lseek(fd_, 0, SEEK_END) < 0) {
+        close(fd_);
+        throw runtime_error("Cannot open "s + path_);
+    }
+    if (valid_size == 0) {
+        Put(buffer_, WAL_FILE_MAGIC);
+        Put(buffer_, WAL_FILE_VERSION);
+        Sync();
+    }
+    if (sync_policy_ == WalSyncPolicy::PERIODIC) {
+        sync_thread_ = thread([this]() { SyncLoop(); });
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (sync_thread_.joinable()) {
+        {
+            lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        unsynced_.notify_all();
+        sync_thread_.join();
+    }
+    try {
+        Sync();
+    } catch (const exception&) {
+    }
+    close(fd_);
+}
+
+uint64_t WriteAheadLog::AppendAdd(const vector<NewDocument>& documents) {
+    string body;
+    Put(body, WalRecordType::ADD_DOCUMENTS);
+    Put(body, static_cast<uint64_t>(documents.size()));
+    for (const NewDocument& document : documents) {
+        Put(body, static_cast<int32_t>(document.id));
+        Put(body, static_cast<int32_t>(document.status));
+        Put(body, static_cast<uint64_t>(document.ratings.size()));
+        for (const int rating : document.ratings) {
+            Put(body, static_cast<int32_t>(rating));
+        }
+        Put(body, static_cast<uint64_t>(document.text.size()));
+        body += document.text;
+    }
+    return Append(body);
+}
+
+uint64_t WriteAheadLog::AppendRemove(WalRecordType type, const vector<int>& document_ids) {
+    string body;
+    Put(body, type);
+    Put(body, static_cast<uint64_t>(document_ids.size()));
+    for (const int document_id : document_ids) {
+        Put(body, static_cast<int32_t>(document_id));
+    }
+    return Append(body);
+}
+
+uint64_t WriteAheadLog::Append(const string& body) {
+    if (body.size() > numeric_limits<uint32_t>::max()) {
+        throw invalid_argument("Record is too large for write-ahead log"s);
+    }
+    const WalRecordHeader header{ static_cast<uint32_t>(body.size()), ComputeCrc(body) };
+    lock_guard lock(mutex_);
+    if (broken_) {
+        throw runtime_error("Write-ahead log "s + path_ + " is broken"s);
+    }
+    Put(buffer_, header);
+    buffer_ += body;
+    if (appended_ == synced_) {
+        first_unsynced_ = chrono::steady_clock::now();
+        unsynced_.notify_all();
+    }
+    return ++appended_;
+}
+
+void WriteAheadLog::Commit(uint64_t sequence) {
+    unique_lock lock(mutex_);
+    while (written_ < sequence || (sync_policy_ == WalSyncPolicy::ALWAYS && synced_ < sequence)) {
+        if (broken_) {
+            throw runtime_error("Write-ahead log "s + path_ + " is broken"s);
+        }
+        if (flushing_) {
+            // запись уже пишет другой поток; когда он закончит, наша запись, возможно, уже на диске
+            flushed_.wait(lock);
+            continue;
+        }
+        Flush(lock, sync_policy_ == WalSyncPolicy::ALWAYS);
+    }
+}
+
+void WriteAheadLog::Sync() {
+    unique_lock lock(mutex_);
+    while (synced_ < appended_ || !buffer_.empty()) {
+        if (broken_) {
+            throw runtime_error("Write-ahead log "s + path_ + " is broken"s);
+        }
+        if (flushing_) {
+            flushed_.wait(lock);
+            continue;
+        }
+        Flush(lock, true);
+    }
+}
+
+void WriteAheadLog::Flush(unique_lock<mutex>& lock, bool sync) {
+    flushing_ = true;
+    string data;
+    data.swap(buffer_);
+    const uint64_t target = appended_;
+    const auto started = chrono::steady_clock::now();
+    lock.unlock();
+    bool failed = false;
+    try {
+        WriteAll(fd_, data, path_);
+        if (sync && fdatasync(fd_) != 0) {
+            throw runtime_error("Cannot sync "s + path_);
+        }
+    } catch (const runtime_error&) {
+        failed = true;
+    }
+    lock.lock();
+    flushing_ = false;
+    if (failed) {
+        broken_ = true;
+    } else {
+        written_ = target;
+        if (sync) {
+            synced_ = target;
+            // записи, добавленные во время fsync, появились не раньше его начала
+            first_unsynced_ = started;
+        }
+    }
+    flushed_.notify_all();
+    if (failed) {
+        throw runtime_error("Cannot write "s + path_);
+    }
+}
+
+void WriteAheadLog::SyncLoop() {
+    unique_lock lock(mutex_);
+    while (!stopping_ && !broken_) {
+        if (synced_ == appended_) {
+            unsynced_.wait(lock);
+            continue;
+        }
+        const auto deadline = first_unsynced_ + sync_interval_;
+        if (chrono::steady_clock::now() < deadline) {
+            unsynced_.wait_until(lock, deadline);
+            continue;
+        }
+        if (flushing_) {
+            flushed_.wait(lock);
+            continue;
+        }
+        try {
+            Flush(lock, true);
+        } catch (const runtime_error&) {
+            // журнал сломан; ошибку получат Commit и Sync
+        }
+    }
+}
+
+void SyncPath(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    const bool synced = fsync(fd) == 0;
+    close(fd);
+    if (!synced) {
+        throw runtime_error("Cannot sync "s + path);
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+
+// журнал изменений индекса, по порядку:
+//   заголовок: WAL_FILE_MAGIC, WAL_FILE_VERSION
+//   записи: размер тела, его CRC32 и тело - тип записи и её документы
+// запись добавления хранит id, статус, оценки и текст каждого документа, записи удаления - id.
+// недописанная или испорченная запись считается концом журнала: всё, что после неё, отбрасывается.
+// числа записаны в порядке байт машины
+constexpr uint32_t WAL_FILE_MAGIC = 0x4C415753; // "SWAL"
+constexpr uint32_t WAL_FILE_VERSION = 1;
+
+// удаление одного документа и пакета пишутся разными записями: RemoveDocuments чистит списки вхождений,
+// а RemoveDocument нет, и повтор журнала должен пройти тем же путём
+enum class WalRecordType : uint8_t {
+    ADD_DOCUMENTS = 1,
+    REMOVE_DOCUMENT = 2,
+    REMOVE_DOCUMENTS = 3,
+};
+
+struct WalDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+struct WalRecord {
+    WalRecordType type;
+    std::vector<WalDocument> documents; // для ADD_DOCUMENTS
+    std::vector<int> document_ids;      // для REMOVE_DOCUMENT и REMOVE_DOCUMENTS
+};
+
+// когда записи журнала сбрасываются на диск через fsync
+enum class WalSyncPolicy {
+    NONE,     // записи только отдаются ОС: переживают падение процесса, но не отключение питания
+    PERIODIC, // фоновый поток делает fsync через sync_interval после первой несброшенной записи;
+              // при отключении питания теряется не больше интервала записей
+    ALWAYS,   // Commit ждёт fsync; потоки, которые ждут одновременно, делят один fsync на всех
+};
+
+// читает записи журнала по порядку до конца файла или первой испорченной записи
+class WalReader {
+public:
+    explicit WalReader(const std::string& path);
+
+    // false в конце журнала
+    bool Next(WalRecord& record);
+    // размер целой части файла: заголовок и прочитанные записи
+    uint64_t GetValidSize() const;
+
+private:
+    std::ifstream in_;
+    uint64_t file_size_ = 0;
+    uint64_t valid_size_ = 0;
+    bool at_end_ = false;
+};
+
+// журнал, открытый на дозапись. Append кладёт запись в буфер и возвращает её номер,
+// Commit(номер) возвращается, когда запись записана в файл, а при WalSyncPolicy::ALWAYS - и сброшена на диск.
+// буфер пишет один поток, остальные ждут его, поэтому записи всех ожидающих уходят одним write и одним fsync.
+// при WalSyncPolicy::PERIODIC на диск записи сбрасывает фоновый поток. методы можно вызывать из разных потоков
+class WriteAheadLog {
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_SYNC_INTERVAL{ 100 };
+
+    // дописывает существующий журнал, отрезав испорченный хвост, или создаёт новый
+    WriteAheadLog(std::string path, WalSyncPolicy sync_policy, std::chrono::milliseconds sync_interval = DEFAULT_SYNC_INTERVAL);
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    // останавливает фоновый поток и сбрасывает оставшиеся записи на диск
+    ~WriteAheadLog();
+
+    uint64_t AppendAdd(const std::vector<NewDocument>& documents);
+    uint64_t AppendRemove(WalRecordType type, const std::vector<int>& document_ids);
+    void Commit(uint64_t sequence);
+    // пишет и сбрасывает на диск все добавленные записи независимо от политики
+    void Sync();
+
+private:
+    uint64_t Append(const std::string& body);
+    // пишет буфер в файл и, если sync, сбрасывает файл на диск; lock отпускается на время записи
+    void Flush(std::unique_lock<std::mutex>& lock, bool sync);
+    // фоновый поток WalSyncPolicy::PERIODIC
+    void SyncLoop();
+
+    const std::string path_;
+    const WalSyncPolicy sync_policy_;
+    const std::chrono::milliseconds sync_interval_;
+    int fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable flushed_;
+    std::string buffer_;
+    uint64_t appended_ = 0; // номер последней добавленной записи
+    uint64_t written_ = 0;  // номер последней записи, отданной ОС
+    uint64_t synced_ = 0;   // номер последней записи, сброшенной на диск
+    bool flushing_ = false;
+    // после ошибки записи журнал не принимает новых записей: в файле мог остаться пропуск
+    bool broken_ = false;
+    // когда добавлена самая ранняя запись, ещё не сброшенная на диск
+    std::chrono::steady_clock::time_point first_unsynced_;
+    std::condition_variable unsynced_;
+    bool stopping_ = false;
+    std::thread sync_thread_;
+};
+
+// сбрасывает на диск файл или каталог; бросает runtime_error
+void SyncPath(const std::string& path);